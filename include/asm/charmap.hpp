@@ -27,6 +27,9 @@ size_t charmap_CharSize(std::string const &mapping);
 std::optional<int32_t> charmap_CharValue(std::string const &mapping, size_t idx);
 std::vector<int32_t> charmap_Convert(std::string const &input);
 size_t charmap_ConvertNext(std::string_view &input, std::vector<int32_t> *output);
+// Converts the next character of `input` and advances past it, returning null at the end.
+// The returned units are only valid until the next conversion or mapping.
+std::vector<int32_t> const *charmap_ConvertNextUnits(std::string_view &input);
 std::string charmap_Reverse(std::vector<int32_t> const &value, bool &unique);
 
 #endif // RGBDS_ASM_CHARMAP_HPP
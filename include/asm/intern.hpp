@@ -17,6 +17,7 @@ public:
 
 	std::string const &str() const;
 	char const *c_str() const { return str().c_str(); }
+	size_t getIndex() const { return index; }
 
 	bool operator==(InternedStr const &rhs) const { return index == rhs.index; }
 
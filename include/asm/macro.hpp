@@ -11,6 +11,8 @@
 struct MacroArgs {
 	uint32_t shift;
 	std::vector<std::shared_ptr<std::string>> args;
+	// `\#` is joined once, and reused until the arguments change or are shifted
+	mutable std::shared_ptr<std::string> allArgs = nullptr;
 
 	uint32_t nbArgs() const { return args.size() - shift; }
 	std::shared_ptr<std::string> getArg(int32_t num) const;
@@ -28,6 +28,7 @@ struct Options {
 	MissingInclude missingIncludeState = INC_ERROR; // -MC, -MG
 	bool generatePhonyDeps = false;                 // -MP
 	std::optional<std::string> objectFileName{};    // -o
+	bool compactObject = false;                     // --compact-object
 	uint8_t padByte = 0;                            // -p
 	uint64_t maxErrors = 0;                         // -X
 
@@ -14,25 +14,37 @@
 
 struct Symbol;
 
-struct RPNValue {
-	RPNCommand command;                                                // The RPN_* command ID
-	std::variant<std::monostate, uint8_t, uint32_t, InternedStr> data; // Data after the ID, if any
-
-	RPNValue(RPNCommand cmd);
-	RPNValue(RPNCommand cmd, uint8_t val);
-	RPNValue(RPNCommand cmd, uint32_t val);
-	RPNValue(RPNCommand cmd, InternedStr name);
-
-	void appendEncoded(std::vector<uint8_t> &buffer) const;
+// Why an expression is not known; only turned into a message if a constant is required
+struct UnknownReason {
+	enum Kind : uint8_t {
+		PC_VALUE,
+		SYM_VALUE,
+		SYM_UNDEFINED,
+		PC_BANK,
+		SYM_BANK,
+		SECT_BANK,
+		SECT_SIZE,
+		SECT_START,
+		SECTTYPE_SIZE,
+		SECTTYPE_START,
+	};
+
+	Kind kind;
+	bool wasPurged = false;
+	InternedStr name{}; // The symbol's or section's name, if any
+
+	std::string format() const;
 };
 
 struct Expression {
 	std::variant<
-	    int32_t,    // If the expression's value is known, it's here
-	    std::string // Why the expression is not known, if it isn't
+	    int32_t,      // If the expression's value is known, it's here
+	    UnknownReason // Why the expression is not known, if it isn't
 	    >
 	    data = 0;
-	std::vector<RPNValue> rpn{}; // Values to be serialized into the RPN expression
+	// The RPN expression, encoded as in object files, except that symbols and sections are
+	// referred to by the index of their interned name (as four bytes) until `encode` resolves them
+	std::vector<uint8_t> rpn{};
 
 	bool isKnown() const { return std::holds_alternative<int32_t>(data); }
 	int32_t value() const { return std::get<int32_t>(data); }
@@ -58,6 +70,7 @@ struct Expression {
 
 	void checkNBit(uint8_t n) const;
 
+	// Appends the RPN expression to `buffer`, which may be shared with other expressions
 	void encode(std::vector<uint8_t> &buffer) const;
 };
 
@@ -25,7 +25,8 @@ struct Patch {
 	Section *pcSection;
 	uint32_t pcOffset;
 	uint8_t type;
-	std::vector<uint8_t> rpn;
+	uint32_t rpnOffset; // Within the RPN pool of the patch's owner
+	uint32_t rpnSize;
 };
 
 struct Section {
@@ -40,6 +41,7 @@ struct Section {
 	uint8_t align; // Exactly as specified in `ALIGN[]`
 	uint16_t alignOfs;
 	std::deque<Patch> patches;
+	std::vector<uint8_t> rpnPool; // RPN expressions of all `patches`, back to back
 	std::vector<uint8_t> data;
 
 	uint32_t getID() const; // ID of the section in the object file (`UINT32_MAX` if none)
@@ -78,7 +80,7 @@ uint32_t sect_GetSymbolOffset();
 uint32_t sect_GetOutputOffset();
 std::optional<uint32_t> sect_GetOutputBank();
 
-Patch *sect_AddOutputPatch();
+Section *sect_GetOutputSection();
 
 uint32_t sect_GetAlignBytes(uint8_t alignment, uint16_t offset);
 void sect_AlignPC(uint8_t alignment, uint16_t offset);
@@ -91,9 +93,9 @@ void sect_EndUnion();
 void sect_CheckUnionClosed();
 
 void sect_ConstByte(uint8_t byte);
-void sect_ByteString(std::vector<int32_t> const &str);
-void sect_WordString(std::vector<int32_t> const &str);
-void sect_LongString(std::vector<int32_t> const &str);
+void sect_ByteString(std::string const &str);
+void sect_WordString(std::string const &str);
+void sect_LongString(std::string const &str);
 void sect_Skip(uint32_t skip, bool ds);
 void sect_RelByte(Expression const &expr, uint32_t pcShift);
 void sect_RelBytes(uint32_t n, std::vector<Expression> const &exprs);
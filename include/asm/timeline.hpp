@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+
+// Trace events for `--trace-events`, which can be loaded into Perfetto or `chrome://tracing`
+
+#ifndef RGBDS_ASM_TIMELINE_HPP
+#define RGBDS_ASM_TIMELINE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+struct FileStackNode;
+
+void timeline_Open(std::string const &path);
+// Ends any span still open, e.g. the main file's, and finishes writing the events
+void timeline_Close();
+
+// `node` and `lineNo` are where the span was entered from; `node` is null for the main file
+void timeline_Begin(
+    char const *category, std::string_view name, FileStackNode const *node, uint32_t lineNo
+);
+void timeline_End();
+
+// Spans `INCBIN`, `READFILE`, etc. until the end of its scope, at the current location
+class TimelineSpan {
+	bool _isOpen = false;
+
+public:
+	TimelineSpan(char const *category, std::string const &name);
+	~TimelineSpan();
+
+	TimelineSpan(TimelineSpan const &) = delete;
+	TimelineSpan &operator=(TimelineSpan const &) = delete;
+};
+
+#endif // RGBDS_ASM_TIMELINE_HPP
@@ -7,9 +7,11 @@
 #include <fstream>
 #include <ios>
 #include <iostream>
+#include <stdint.h>
 #include <streambuf>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "helpers.hpp" // assume
 #include "platform.hpp"
@@ -46,6 +48,52 @@ public:
 	}
 	std::streambuf *operator->() { return &**this; }
 
+	// Reads the rest of the file at once.
+	std::vector<uint8_t> readAll() {
+		std::streambuf &file = **this;
+
+		// If the file's size can be known (i.e. it is seekable), make room for all of it, plus one
+		// byte so that its end is reached by the first read; otherwise, begin with some room.
+		size_t initialSize = 128 * 16;
+		if (std::streamoff pos = file.pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+		    pos != -1) {
+			std::streamoff end = file.pubseekoff(0, std::ios_base::end, std::ios_base::in);
+			if (file.pubseekpos(pos, std::ios_base::in) == pos && end >= pos) {
+				initialSize = end - pos + 1;
+			}
+		}
+		std::vector<uint8_t> data(initialSize);
+
+		size_t curSize = 0;
+		for (;;) {
+			size_t oldSize = curSize;
+			curSize = data.size();
+
+			// Fill the new area ([oldSize; curSize[) with bytes
+			size_t nbRead =
+			    file.sgetn(reinterpret_cast<char *>(&data.data()[oldSize]), curSize - oldSize);
+			if (nbRead != curSize - oldSize) {
+				// Shrink the vector to discard bytes that weren't read
+				data.resize(oldSize + nbRead);
+				break;
+			}
+			// If the vector has some capacity left, use it; otherwise, double the current size
+
+			// Arbitrary, but if you got a better idea...
+			size_t newSize = oldSize != data.capacity() ? data.capacity() : oldSize * 2;
+			assume(oldSize != newSize);
+			data.resize(newSize);
+		}
+
+		return data;
+	}
+
+	// Writes all of the data at once, and returns whether it was entirely written.
+	bool writeAll(std::vector<uint8_t> const &data) {
+		return (*this)->sputn(reinterpret_cast<char const *>(data.data()), data.size())
+		       == static_cast<std::streamsize>(data.size());
+	}
+
 	char const *c_str(std::string const &path) const {
 		return std::holds_alternative<std::filebuf>(_file)             ? path.c_str()
 		       : std::get<std::streambuf *>(_file) == std::cin.rdbuf() ? "<stdin>"
@@ -3,6 +3,9 @@
 #ifndef RGBDS_FIX_FIX_HPP
 #define RGBDS_FIX_FIX_HPP
 
-bool fix_ProcessFile(char const *name, char const *outputName);
+struct FileDiagnostics;
+
+// Returns whether fixing the file failed
+bool fix_ProcessFile(char const *name, char const *outputName, FileDiagnostics &diags);
 
 #endif // RGBDS_FIX_FIX_HPP
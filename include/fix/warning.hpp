@@ -3,7 +3,11 @@
 #ifndef RGBDS_FIX_WARNING_HPP
 #define RGBDS_FIX_WARNING_HPP
 
+#include <optional>
 #include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "diagnostics.hpp"
 
@@ -27,6 +31,22 @@ enum WarningID {
 
 extern Diagnostics<WarningLevel, WarningID> warnings;
 
+// The diagnostics reported while fixing a single file
+struct FileDiagnostics {
+	uint64_t nbErrors = 0;
+	// When fixing several files concurrently, diagnostics are held here instead of being printed,
+	// so that they can be printed in the order of the files afterwards
+	bool deferred = false;
+	std::vector<std::pair<std::optional<WarningID>, std::string>> messages; // No ID for errors
+	std::string name; // Set by `checkErrors`, which is when the error count is due
+
+	// Prints the deferred diagnostics, followed by the error count if there were any errors
+	void print() const;
+};
+
+// Attributes the calling thread's diagnostics to this file, until it is set back to `nullptr`
+void setFileDiagnostics(FileDiagnostics *diags);
+
 // Warns the user about problems that don't prevent fixing the ROM header
 [[gnu::format(printf, 2, 3)]]
 void warning(WarningID id, char const *fmt, ...);
@@ -39,6 +59,7 @@ void error(char const *fmt, ...);
 [[gnu::format(printf, 1, 2), noreturn]]
 void fatal(char const *fmt, ...);
 
-uint32_t checkErrors(char const *filename);
+// Returns how many errors the current file had, printing that number if there were any
+uint64_t checkErrors(char const *filename);
 
 #endif // RGBDS_FIX_WARNING_HPP
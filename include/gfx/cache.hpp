@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef RGBDS_GFX_CACHE_HPP
+#define RGBDS_GFX_CACHE_HPP
+
+#include <array>
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+struct Png;
+
+enum CachedOutput {
+	OUTPUT_TILES,
+	OUTPUT_TILEMAP,
+	OUTPUT_ATTRMAP,
+	OUTPUT_PALMAP,
+	OUTPUT_PALETTES,
+
+	NB_CACHED_OUTPUTS
+};
+
+// The contents of each output file that was written by a conversion
+using CachedOutputs = std::array<std::optional<std::vector<uint8_t>>, NB_CACHED_OUTPUTS>;
+
+struct CacheKey {
+	// Everything that the outputs depend on, stored in the entry to tell apart colliding hashes
+	std::vector<uint8_t> material;
+	uint64_t hash; // Names the entry
+};
+
+// Serializes everything that the outputs of converting this image depend on.
+// Returns nothing if some of the inputs cannot be read (e.g. a tileset read from stdin).
+std::optional<CacheKey> computeCacheKey(Png const &png);
+// Returns the outputs stored under this key in the cache directory, if any
+std::optional<CachedOutputs> loadFromCache(CacheKey const &key);
+// Stores the outputs under this key in the cache directory; failing to do so is not an error
+void storeInCache(CacheKey const &key, CachedOutputs const &outputs);
+
+#endif // RGBDS_GFX_CACHE_HPP
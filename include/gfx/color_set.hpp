@@ -4,6 +4,7 @@
 #define RGBDS_GFX_COLOR_SET_HPP
 
 #include <array>
+#include <functional>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -14,21 +15,30 @@ public:
 private:
 	// Up to 4 colors, sorted, and where UINT16_MAX means the slot is empty
 	// (OK because it's not a valid color index)
-	// Sorting is done on the raw numerical values to lessen `compare`'s complexity
+	// Sorting is done on the raw numerical values, so that equal sets are stored identically
 	std::array<uint16_t, capacity> _colorIndices{UINT16_MAX, UINT16_MAX, UINT16_MAX, UINT16_MAX};
 
 public:
 	// Adds the specified color to the set, or **silently drops it** if the set is full.
 	void add(uint16_t color);
 
-	enum ComparisonResult { INCOMPARABLE, SUBSET_OR_EQUAL, STRICT_SUPERSET };
-	ComparisonResult compare(ColorSet const &other) const;
+	// Returns the set made of the colors whose indices (in sorted order) are set in `mask`.
+	ColorSet subset(unsigned mask) const;
+
+	bool operator==(ColorSet const &rhs) const { return _colorIndices == rhs._colorIndices; }
 
 	size_t size() const;
 	bool empty() const;
 
 	decltype(_colorIndices)::const_iterator begin() const;
 	decltype(_colorIndices)::const_iterator end() const;
+
+	size_t hash() const;
+};
+
+template<>
+struct std::hash<ColorSet> {
+	size_t operator()(ColorSet const &colorSet) const { return colorSet.hash(); }
 };
 
 #endif // RGBDS_GFX_COLOR_SET_HPP
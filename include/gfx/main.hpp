@@ -23,6 +23,7 @@ struct Options {
 	std::string attrmap{};                    // -a, -A
 	std::optional<Rgba> bgColor{};            // -B
 	std::array<uint8_t, 2> baseTileIDs{0, 0}; // -b
+	std::string cacheDir{};                   // --cache
 	enum {
 		NO_SPEC,
 		EXPLICIT,
@@ -42,9 +43,11 @@ struct Options {
 		uint32_t bottom() const { return top + height * 8; }
 	} inputSlice{0, 0, 0, 0};                          // -L (margins in clockwise order, like CSS)
 	uint8_t basePalID = 0;                             // -l
+	std::optional<uint8_t> compressionLevel{};         // --compression
 	std::array<uint16_t, 2> maxNbTiles{UINT16_MAX, 0}; // -N
 	uint16_t nbPalettes = 8;                           // -n
 	std::string output{};                              // -o
+	uint16_t packTime = 0;                             // --pack-time, in milliseconds
 	std::string palettes{};                            // -p, -P
 	std::string palmap{};                              // -q, -Q
 	uint16_t reversedWidth = 0;                        // -r, in tiles
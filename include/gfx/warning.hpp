@@ -3,6 +3,8 @@
 #ifndef RGBDS_GFX_WARNING_HPP
 #define RGBDS_GFX_WARNING_HPP
 
+#include <stdint.h>
+
 #include "diagnostics.hpp"
 
 enum WarningLevel {
@@ -34,6 +36,9 @@ void giveUp();
 // If any error has been emitted thus far, calls `giveUp()`
 void requireZeroErrors();
 
+// Returns how many warnings and errors have been printed thus far
+uint64_t getNbDiagnostics();
+
 // Prints an error, and increments the error count
 [[gnu::format(printf, 1, 2)]]
 void error(char const *fmt, ...);
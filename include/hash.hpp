@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef RGBDS_HASH_HPP
+#define RGBDS_HASH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 64-bit FNV-1a; this only needs to tell inputs apart, not to resist forgeries
+class Hasher {
+	uint64_t _hash = 0xCBF29CE484222325;
+
+public:
+	uint64_t value() const { return _hash; }
+
+	void addBytes(uint8_t const *data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			_hash = (_hash ^ data[i]) * 0x100000001B3;
+		}
+	}
+
+	template<typename T>
+	    requires std::is_integral_v<T>
+	void add(T value) {
+		// Hash integers byte by byte, so that keys do not depend on the host's endianness
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			uint8_t byte = static_cast<uint64_t>(value) >> (i * 8);
+			addBytes(&byte, 1);
+		}
+	}
+
+	void add(std::string const &str) {
+		add(str.size());
+		addBytes(reinterpret_cast<uint8_t const *>(str.data()), str.size());
+	}
+
+	void add(std::vector<uint8_t> const &data) {
+		add(data.size());
+		addBytes(data.data(), data.size());
+	}
+};
+
+#endif // RGBDS_HASH_HPP
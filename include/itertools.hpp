@@ -4,6 +4,7 @@
 #define RGBDS_ITERTOOLS_HPP
 
 #include <deque>
+#include <functional> // equal_to, hash
 #include <optional>
 #include <stddef.h>
 #include <string>
@@ -36,10 +37,15 @@ ReversedIterable<IterableT> reversed(IterableT &&_iterable) {
 }
 
 // A map from `KeyT` keys to `ItemT` items, iterable in the order the items were inserted.
-template<typename KeyT, typename ItemT>
+template<
+    typename KeyT,
+    typename ItemT,
+    typename HashT = std::hash<KeyT>,
+    typename EqualT = std::equal_to<KeyT>>
 class InsertionOrderedMap {
-	std::deque<ItemT> list;               // `deque` does not invalidate item references
-	std::unordered_map<KeyT, size_t> map; // Indexes into `list`
+	std::deque<ItemT> list; // `deque` does not invalidate item references
+	// Indexes into `list`
+	std::unordered_map<KeyT, size_t, HashT, EqualT> map;
 
 public:
 	size_t size() const { return list.size(); }
@@ -77,7 +83,9 @@ public:
 		return list.emplace_back();
 	}
 
-	std::optional<size_t> findIndex(KeyT const &key) const {
+	// With a transparent `HashT` and `EqualT`, keys can be looked up without converting them
+	template<typename LookupT>
+	std::optional<size_t> findIndex(LookupT const &key) const {
 		if (auto search = map.find(key); search != map.end()) {
 			return search->second;
 		}
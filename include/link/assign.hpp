@@ -3,7 +3,14 @@
 #ifndef RGBDS_LINK_ASSIGN_HPP
 #define RGBDS_LINK_ASSIGN_HPP
 
+#include <stdint.h>
+
+struct Section;
+
 // Assigns all sections a slice of the address space
 void assign_AssignSections();
 
+// Puts a section back where a previous link assigned it
+void assign_RestoreSection(Section &section, uint32_t bank, uint16_t org);
+
 #endif // RGBDS_LINK_ASSIGN_HPP
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef RGBDS_LINK_INCREMENTAL_HPP
+#define RGBDS_LINK_INCREMENTAL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "linkdefs.hpp"
+
+struct Symbol;
+
+// Registers an object file, to later tell whether it changed since the previous link
+void incr_AddObject(
+    std::string const &path, size_t fileID, std::vector<Symbol> const &fileSymbols
+);
+
+// Places all sections where the previous link did, if nothing that could affect their placement
+// changed since then.
+// Returns whether it did; otherwise, the sections still have to be assigned.
+bool incr_RestorePlacement();
+// Finds which banks of the output need to be rewritten, once all sections have been loaded, since
+// objects' hashes cover their deferred payloads
+void incr_FindDirtyBanks();
+
+// Whether the output ROM is being updated in place, instead of being written from scratch
+bool incr_IsReusingOutput();
+// Whether a bank has to be patched and written; `bank` is relative to the type's first bank
+bool incr_IsBankDirty(SectionType type, uint32_t bank);
+
+// Sums of ROMX banks (including padding), to compute the global checksum without clean banks
+uint16_t incr_GetBankSum(uint32_t bank);
+void incr_SetBankSum(uint32_t bank, uint16_t sum);
+
+// Writes the state file for the next link, once the output has been written
+void incr_SaveState();
+
+#endif // RGBDS_LINK_INCREMENTAL_HPP
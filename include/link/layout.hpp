@@ -4,7 +4,7 @@
 #define RGBDS_LINK_LAYOUT_HPP
 
 #include <stdint.h>
-#include <string>
+#include <string_view>
 
 #include "linkdefs.hpp"
 
@@ -17,6 +17,6 @@ void layout_MakeAddrFloating();
 void layout_AlignTo(uint32_t alignment, uint32_t offset);
 void layout_Pad(uint32_t length);
 
-void layout_PlaceSection(std::string const &name, bool isOptional);
+void layout_PlaceSection(std::string_view name, bool isOptional);
 
 #endif // RGBDS_LINK_LAYOUT_HPP
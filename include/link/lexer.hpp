@@ -4,10 +4,11 @@
 #define RGBDS_LINK_LEXER_HPP
 
 #include <string>
+#include <string_view>
 
 void lexer_TraceCurrent();
 
-void lexer_IncludeFile(std::string &&path);
+void lexer_IncludeFile(std::string_view path);
 void lexer_IncLineNo();
 
 bool lexer_Init(std::string const &linkerScriptName);
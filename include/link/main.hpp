@@ -23,6 +23,12 @@ struct Options {
 	bool is32kMode;      // -t
 	bool isWRAM0Mode;    // -w
 	bool disablePadding; // -x
+
+	bool fixHeader;                   // --fix-header
+	std::optional<uint8_t> mbcType;   // --mbc-type
+	std::optional<std::string> title; // --title
+
+	std::optional<std::string> stateFileName; // --incremental
 };
 
 extern Options options;
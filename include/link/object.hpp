@@ -4,10 +4,22 @@
 #define RGBDS_LINK_OBJECT_HPP
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string>
+#include <vector>
+
+struct Symbol;
 
 // Read an object (.o) file, and add its info to the data structures.
-void obj_ReadFile(std::string const &filePath, size_t fileID);
+// Returns the file's symbols, which its sections refer to through `fileSymbols`.
+std::vector<Symbol> const &obj_ReadFile(std::string const &filePath, size_t fileID);
+
+// Reads the data and patches of sections whose reading was deferred by `obj_ReadFile`
+void obj_LoadSections();
+
+// Hash of all that was read from an object file, which is only complete after `obj_LoadSections`;
+// only computed for incremental links
+uint64_t obj_GetHash(size_t fileID);
 
 // Sets up object file reading
 void obj_Setup(size_t nbFiles);
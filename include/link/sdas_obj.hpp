@@ -6,9 +6,13 @@
 #include <stdio.h>
 #include <vector>
 
+class Hasher;
 struct FileStackNode;
 struct Symbol;
 
-void sdobj_ReadFile(FileStackNode const &where, FILE *file, std::vector<Symbol> &fileSymbols);
+// `hasher`, if any, is given all the bytes read
+void sdobj_ReadFile(
+    FileStackNode const &where, FILE *file, std::vector<Symbol> &fileSymbols, Hasher *hasher
+);
 
 #endif // RGBDS_LINK_SDAS_OBJ_HPP
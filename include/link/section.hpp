@@ -6,6 +6,7 @@
 #include <memory>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "helpers.hpp" // QualifiedEquivalent
@@ -44,8 +45,12 @@ struct Section {
 	uint16_t alignOfs;
 	FileStackNode const *src;
 	int32_t lineNo;
-	std::vector<uint8_t> data; // Array of size `size`, or 0 if `type` does not have data
+	// Array of size `size`, or 0 if `type` does not have data.
+	// Fragments keep their own bytes, which only get gathered when outputting the ROM.
+	std::vector<uint8_t> data;
 	std::vector<Patch> patches;
+	// Whether `data` and `patches` are still in a compact object, until `obj_LoadSections`
+	bool isDataDeferred = false;
 	// Extra info computed during linking
 	std::vector<Symbol> *fileSymbols;
 	std::vector<Symbol *> symbols;
@@ -83,6 +88,15 @@ private:
 public:
 	PiecesIterable<Section> pieces() { return PiecesIterable(this); }
 	PiecesIterable<Section const> pieces() const { return PiecesIterable(this); }
+
+	bool hasData() const {
+		for (Section const &piece : pieces()) {
+			if (!piece.data.empty() || piece.isDataDeferred) {
+				return true;
+			}
+		}
+		return false;
+	}
 };
 
 // Execute a callback for each section currently registered.
@@ -93,7 +107,7 @@ void sect_ForEach(void (*callback)(Section &));
 void sect_AddSection(std::unique_ptr<Section> &&section);
 
 // Finds a section by its name.
-Section *sect_GetSection(std::string const &name);
+Section *sect_GetSection(std::string_view name);
 
 // Checks if all sections meet reasonable criteria, such as max size
 void sect_DoSanityChecks();
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <variant>
 
 #include "linkdefs.hpp"
@@ -32,6 +33,8 @@ struct Symbol {
 	    Label    // Label values refer to an offset within a specific section
 	    >
 	    data;
+	// Extra info computed during linking
+	Symbol const *definition = nullptr; // The exported symbol that an import refers to
 
 	void linkToSection(Section &section);
 	void fixSectionOffset();
@@ -42,8 +45,11 @@ void sym_ForEach(void (*callback)(Symbol &));
 void sym_AddSymbol(Symbol &symbol);
 
 // Finds a symbol in all the defined symbols.
-Symbol *sym_GetSymbol(std::string const &name);
+Symbol *sym_GetSymbol(std::string_view name);
+
+// Points all imported symbols to their definitions, once all object files have been read
+void sym_ResolveImports();
 
-void sym_TraceLocalAliasedSymbols(std::string const &name);
+void sym_TraceLocalAliasedSymbols(std::string_view name);
 
 #endif // RGBDS_LINK_SYMBOL_HPP
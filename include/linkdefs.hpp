@@ -10,6 +10,7 @@
 
 #define RGBDS_OBJECT_VERSION_STRING "RGB9"
 #define RGBDS_OBJECT_REV            13U
+#define RGBDS_OBJECT_REV_COMPACT    14U // Opt-in, with varints and a string table
 
 enum AssertionType { ASSERT_WARN, ASSERT_ERROR, ASSERT_FATAL };
 
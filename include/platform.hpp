@@ -35,6 +35,22 @@
 	#include <unistd.h> // IWYU pragma: export
 #endif
 
+// Windows has neither `mmap` nor `ftruncate`, so it only gets the slower paths that use `read`
+#if defined(_MSC_VER) || defined(__MINGW32__)
+	#define HAVE_MMAP 0
+#else
+	#include <sys/mman.h> // IWYU pragma: export
+	#define HAVE_MMAP 1
+#endif
+
+// Windows has no `getrusage`, so profiling can only measure CPU time with `clock` there
+#if defined(_MSC_VER) || defined(__MINGW32__)
+	#define HAVE_GETRUSAGE 0
+#else
+	#include <sys/resource.h> // IWYU pragma: export
+	#define HAVE_GETRUSAGE 1
+#endif
+
 // MSVC uses a different name for O_RDWR, and needs an additional _O_BINARY flag
 #ifdef _MSC_VER
 	#include <fcntl.h> // IWYU pragma: export
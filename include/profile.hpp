@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+
+// Per-phase timing and counters, reported with `--profile`
+
+#ifndef RGBDS_PROFILE_HPP
+#define RGBDS_PROFILE_HPP
+
+#include <stdint.h>
+
+// A phase accumulates the time and allocations spent in it, excluding nested phases.
+// Phases must have static storage duration, since they are only reported at exit.
+struct ProfilePhase {
+	char const *name;
+	uint32_t order = 0; // When this phase was first entered, 0 if never
+	uint64_t nbCalls = 0;
+	int64_t wallNs = 0;
+	int64_t cpuUs = 0;
+	uint64_t nbAllocations = 0;
+
+	explicit ProfilePhase(char const *name_);
+};
+
+// Attributes everything until the end of its scope to a phase, if profiling is enabled
+class ProfileScope {
+	ProfilePhase *_phase = nullptr;
+	ProfileScope *_parent;
+	int64_t _startWallNs, _childWallNs = 0;
+	int64_t _startCpuUs, _childCpuUs = 0;
+	uint64_t _startAllocations, _childAllocations = 0;
+
+public:
+	explicit ProfileScope(ProfilePhase &phase);
+	~ProfileScope() { end(); }
+
+	// Attributes everything so far to the phase, and stops; this must be the innermost scope
+	void end();
+
+	ProfileScope(ProfileScope const &) = delete;
+	ProfileScope &operator=(ProfileScope const &) = delete;
+};
+
+// Counters are cheap enough to always be incremented, even if profiling is disabled
+struct ProfileCounter {
+	char const *name;
+	uint64_t value = 0;
+
+	explicit ProfileCounter(char const *name_);
+
+	ProfileCounter &operator+=(uint64_t amount) {
+		value += amount;
+		return *this;
+	}
+	ProfileCounter &operator++() { return *this += 1; }
+};
+
+// Parses the argument to `--profile`, and enables profiling if it is valid
+bool profile_Parse(char const *format);
+
+// Prints all phases and counters to stderr when the program exits, if profiling is enabled;
+// this includes exiting because of errors
+void profile_ReportAtExit(char const *programName);
+
+#endif // RGBDS_PROFILE_HPP
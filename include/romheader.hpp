@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+
+// Cartridge header logic shared by RGBFIX and RGBLINK
+
+#ifndef RGBDS_ROMHEADER_HPP
+#define RGBDS_ROMHEADER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// clang-format off: vertically align values
+static constexpr uint16_t HEADER_LOGO         = 0x104;
+static constexpr uint16_t HEADER_TITLE        = 0x134;
+static constexpr uint16_t HEADER_MANUFACTURER = 0x13F;
+static constexpr uint16_t HEADER_CGB_FLAG     = 0x143;
+static constexpr uint16_t HEADER_NEW_LICENSEE = 0x144;
+static constexpr uint16_t HEADER_SGB_FLAG     = 0x146;
+static constexpr uint16_t HEADER_CART_TYPE    = 0x147;
+static constexpr uint16_t HEADER_ROM_SIZE     = 0x148;
+static constexpr uint16_t HEADER_RAM_SIZE     = 0x149;
+static constexpr uint16_t HEADER_DESTINATION  = 0x14A;
+static constexpr uint16_t HEADER_OLD_LICENSEE = 0x14B;
+static constexpr uint16_t HEADER_ROM_VERSION  = 0x14C;
+static constexpr uint16_t HEADER_CHECKSUM     = 0x14D;
+static constexpr uint16_t HEADER_GLOBAL_SUM   = 0x14E;
+static constexpr uint16_t HEADER_END          = 0x150;
+// clang-format on
+
+extern uint8_t const nintendoLogo[48];
+
+// How many characters of the title fit in the header, since the manufacturer code and the CGB
+// flag take up its last bytes
+uint8_t header_MaxTitleLen(bool hasManufacturerCode, bool hasCGBFlag);
+
+// Writes fields over a ROM0 buffer, which must contain at least the whole header
+class HeaderWriter {
+	uint8_t *_rom0;
+	// Called with a field's name if writing it changed any non-zero byte
+	void (*_warnOverwrite)(char const *fieldName);
+
+public:
+	HeaderWriter(uint8_t *rom0, void (*warnOverwrite)(char const *fieldName))
+	    : _rom0(rom0), _warnOverwrite(warnOverwrite) {}
+
+	void writeBytes(uint16_t addr, uint8_t const *bytes, size_t size, char const *fieldName);
+	void writeByte(uint16_t addr, uint8_t byte, char const *fieldName) {
+		writeBytes(addr, &byte, 1, fieldName);
+	}
+
+	void writeLogo(uint8_t const (&logo)[48], char const *fieldName);
+	// Writes the first `len` characters of the title
+	void writeTitle(std::string const &title, size_t len);
+	void writeCartridgeType(uint8_t type);
+	// These must be written after all of the bytes that they cover; `invert` writes them wrong
+	void writeChecksum(bool invert);
+	void writeGlobalChecksum(size_t rom0Len, uint16_t romxSum, bool invert);
+};
+
+// Sums bytes 8 at a time, which compilers can further vectorize; only the low 16 bits matter
+uint16_t header_SumBytes(uint8_t const *data, size_t len);
+
+// Checksum of 0x134-0x14C, which must be computed after all of those bytes have been written
+uint8_t header_Checksum(uint8_t const *rom0);
+// `romxSum` is the sum of all bytes past ROM0; the checksum bytes themselves are not included
+uint16_t header_GlobalChecksum(uint8_t const *rom0, size_t rom0Len, uint16_t romxSum);
+
+// Rounds a bank count up to what can be flashed, i.e. a power of 2 of at least 32 KiB
+uint32_t header_PaddedNbBanks(uint32_t nbBanks);
+// Value of the ROM size byte for a padded bank count
+uint8_t header_RomSizeCode(uint32_t nbBanks);
+
+#endif // RGBDS_ROMHEADER_HPP
@@ -101,6 +101,13 @@ struct Uppercase {
 	}
 };
 
+// Avoid `std::string` allocations when looking up `std::string_view`s in `std::string`-keyed maps
+struct StringHash {
+	using is_transparent = void;
+
+	size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+};
+
 // An unordered map from case-insensitive `std::string_view` keys to `ItemT` items
 template<typename ItemT>
 using UpperMap = std::unordered_map<std::string_view, ItemT, Uppercase, Uppercase>;
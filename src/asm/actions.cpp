@@ -29,6 +29,7 @@
 #include "asm/rpn.hpp" // Expression
 #include "asm/section.hpp"
 #include "asm/symbol.hpp"
+#include "asm/timeline.hpp"
 #include "asm/warning.hpp"
 
 void act_If(int32_t condition) {
@@ -136,6 +137,7 @@ void act_StaticAssert(AssertionType type, int32_t condition, std::string const &
 }
 
 std::optional<std::string> act_ReadFile(std::string const &name, uint32_t maxLen) {
+	TimelineSpan span("READFILE", name);
 	FILE *file = nullptr;
 	if (std::optional<std::string> fullPath = fstk_FindFile(name); fullPath) {
 		file = fopen(fullPath->c_str(), "rb");
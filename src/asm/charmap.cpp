@@ -3,6 +3,7 @@
 #include "asm/charmap.hpp"
 
 #include <algorithm>
+#include <array>
 #include <concepts> // predicate
 #include <map>
 #include <optional>
@@ -13,10 +14,12 @@
 #include <string.h>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "extern/utf8decoder.hpp"
+#include "hash.hpp"
 #include "helpers.hpp"
 #include "itertools.hpp" // InsertionOrderedMap
 #include "util.hpp"
@@ -30,6 +33,16 @@ static bool compareNode(std::pair<char, size_t> edge, char c) {
 	return edge.first < c;
 }
 
+struct UnitsHash {
+	size_t operator()(std::vector<int32_t> const &units) const {
+		Hasher hasher;
+		for (int32_t unit : units) {
+			hasher.add(unit);
+		}
+		return hasher.value();
+	}
+};
+
 struct CharmapNode {
 	// The mapped value, if there exists a mapping that ends here; empty for non-terminal nodes.
 	std::vector<int32_t> value;
@@ -54,6 +67,50 @@ struct Charmap {
 	InternedStr name;
 	std::vector<CharmapNode> nodes; // Trie of mappings (first node is reserved for the root node)
 
+	// The trie as a DFA, with a dense row of transitions per node, kept up to date as nodes are
+	// added. Columns are byte classes, so that bytes which no mapping uses all share the dead
+	// class 0. Rows have room for more classes, and are only widened when that runs out.
+	std::array<uint16_t, 256> byteClasses{};
+	size_t nbClasses = 1;
+	size_t rowSize = 16;
+	std::vector<uint32_t> transitions; // `nodes.size()` rows of `rowSize`; 0 is a dead end
+
+	// Maps each value to the mapping which has it, or to nothing if several do.
+	// Built on the first reverse lookup, and invalidated by any mapping.
+	std::unordered_map<std::vector<int32_t>, std::optional<std::string>, UnitsHash> reverseIndex;
+	bool isReverseIndexed = false;
+
+	void addNode() {
+		nodes.emplace_back();
+		transitions.resize(nodes.size() * rowSize, 0);
+	}
+
+	uint16_t classOf(char c) {
+		uint16_t &byteClass = byteClasses[static_cast<uint8_t>(c)];
+		if (!byteClass) {
+			if (nbClasses == rowSize) {
+				// Doubling the rows' size means that this happens at most a few times
+				size_t newRowSize = std::min(rowSize * 2, byteClasses.size() + 1);
+				std::vector<uint32_t> newTransitions(nodes.size() * newRowSize, 0);
+				for (size_t nodeIdx = 0; nodeIdx < nodes.size(); ++nodeIdx) {
+					std::copy_n(
+					    &transitions[nodeIdx * rowSize],
+					    nbClasses,
+					    &newTransitions[nodeIdx * newRowSize]
+					);
+				}
+				transitions = std::move(newTransitions);
+				rowSize = newRowSize;
+			}
+			byteClass = nbClasses++;
+		}
+		return byteClass;
+	}
+
+	size_t nextDfaIndex(size_t nodeIdx, char c) const {
+		return transitions[nodeIdx * rowSize + byteClasses[static_cast<uint8_t>(c)]];
+	}
+
 	size_t nextIndexOrAdd(size_t nodeIdx, char c) {
 		std::vector<std::pair<char, size_t>> &children = nodes[nodeIdx].children;
 		if (auto pos = std::lower_bound(RANGE(children), c, compareNode);
@@ -61,9 +118,12 @@ struct Charmap {
 			assume(pos->second != 0);
 			return pos->second;
 		} else {
-			auto nextIdx = children.emplace(pos, c, nodes.size());
-			nodes.emplace_back();
-			return nextIdx->second;
+			size_t nextIdx = nodes.size();
+			children.emplace(pos, c, nextIdx);
+			uint16_t byteClass = classOf(c); // This may widen the rows, so get it first
+			addNode();
+			transitions[nodeIdx * rowSize + byteClass] = nextIdx;
+			return nextIdx;
 		}
 	}
 };
@@ -136,9 +196,15 @@ void charmap_New(InternedStr name, InternedStr const *baseName) {
 	Charmap &charmap = charmaps.add(name);
 	charmap.name = name;
 	if (baseIdx) {
-		charmap.nodes = charmaps[*baseIdx].nodes; // Copies `charmaps[*baseIdx].nodes`
+		// Copies the base charmap's trie and DFA
+		Charmap const &base = charmaps[*baseIdx];
+		charmap.nodes = base.nodes;
+		charmap.byteClasses = base.byteClasses;
+		charmap.nbClasses = base.nbClasses;
+		charmap.rowSize = base.rowSize;
+		charmap.transitions = base.transitions;
 	} else {
-		charmap.nodes.emplace_back(); // Zero-init the root node
+		charmap.addNode(); // Zero-init the root node
 	}
 
 	currentCharmap = &charmap;
@@ -185,6 +251,9 @@ void charmap_Add(std::string const &mapping, std::vector<int32_t> &&value) {
 		nodeIdx = charmap.nextIndexOrAdd(nodeIdx, c);
 	}
 
+	charmap.isReverseIndexed = false;
+	charmap.reverseIndex.clear();
+
 	CharmapNode &node = charmap.nodes[nodeIdx];
 	if (node.isTerminal()) {
 		warning(WARNING_CHARMAP_REDEF, "Overriding charmap mapping");
@@ -231,17 +300,29 @@ std::vector<int32_t> charmap_Convert(std::string const &input) {
 }
 
 size_t charmap_ConvertNext(std::string_view &input, std::vector<int32_t> *output) {
+	std::vector<int32_t> const *units = charmap_ConvertNextUnits(input);
+	if (!units) {
+		return 0;
+	}
+
+	if (output) {
+		output->insert(output->end(), RANGE(*units));
+	}
+	return units->size();
+}
+
+std::vector<int32_t> const *charmap_ConvertNextUnits(std::string_view &input) {
 	// The goal is to match the longest mapping possible.
-	// For that, advance through the trie with each character read.
+	// For that, advance through the DFA with each character read.
 	// If that would lead to a dead end, rewind characters until the last match, and output.
 	// If no match, read a UTF-8 codepoint and output that.
 	Charmap const &charmap = *currentCharmap;
+
 	size_t matchIdx = 0;
-	size_t rewindDistance = 0;
-	size_t inputIdx = 0;
+	size_t matchLen = 0;
 
-	for (size_t nodeIdx = 0; inputIdx < input.length();) {
-		nodeIdx = charmap.nodes[nodeIdx].nextIndex(input[inputIdx]);
+	for (size_t nodeIdx = 0, inputIdx = 0; inputIdx < input.length();) {
+		nodeIdx = charmap.nextDfaIndex(nodeIdx, input[inputIdx]);
 
 		if (!nodeIdx) {
 			break;
@@ -251,79 +332,72 @@ size_t charmap_ConvertNext(std::string_view &input, std::vector<int32_t> *output
 
 		if (charmap.nodes[nodeIdx].isTerminal()) {
 			matchIdx = nodeIdx; // This node matches, register it
-			rewindDistance = 0; // If no longer match is found, rewind here
-		} else {
-			++rewindDistance;
+			matchLen = inputIdx; // If no longer match is found, rewind here
 		}
 	}
 
-	// We are at a dead end (either because we reached the end of input, or of the trie),
+	// We are at a dead end (either because we reached the end of input, or of the DFA),
 	// so rewind up to the last match, and output.
-	inputIdx -= rewindDistance; // This will rewind all the way if no match found
-
-	size_t matchLen = 0;
 	if (matchIdx) { // A match was found, use it
-		std::vector<int32_t> const &value = charmap.nodes[matchIdx].value;
-
-		if (output) {
-			output->insert(output->end(), RANGE(value));
-		}
-
-		matchLen = value.size();
-	} else if (inputIdx < input.length()) { // No match found, but there is some input left
-		size_t codepointLen = 0;
-		// This will write the codepoint's value to `output`, little-endian
-		for (Utf8Decoder decoder; inputIdx + codepointLen < input.length();) {
-			if (decoder.update(input[inputIdx + codepointLen]) == UTF8_REJECT) {
-				error("Input string is not valid UTF-8");
-				codepointLen = 1;
-				break;
-			}
-			++codepointLen;
-			if (decoder.state == UTF8_ACCEPT) {
-				break;
-			}
-		}
+		input = input.substr(matchLen);
+		return &charmap.nodes[matchIdx].value;
+	} else if (input.empty()) {
+		return nullptr;
+	}
 
-		if (output) {
-			output->insert(
-			    output->end(), input.data() + inputIdx, input.data() + inputIdx + codepointLen
-			);
+	// No match found, but there is some input left
+	size_t codepointLen = 0;
+	for (Utf8Decoder decoder; codepointLen < input.length();) {
+		if (decoder.update(input[codepointLen]) == UTF8_REJECT) {
+			error("Input string is not valid UTF-8");
+			codepointLen = 1;
+			break;
 		}
-
-		// Warn if this character is not mapped but any others are
-		if (int firstChar = input[inputIdx]; charmap.nodes.size() > 1) {
-			warning(WARNING_UNMAPPED_CHAR_1, "Unmapped character %s", printChar(firstChar));
-		} else if (charmap.name != mainCharmapName) {
-			warning(
-			    WARNING_UNMAPPED_CHAR_2,
-			    "Unmapped character %s not in `%s` charmap",
-			    printChar(firstChar),
-			    mainCharmapName.c_str()
-			);
+		++codepointLen;
+		if (decoder.state == UTF8_ACCEPT) {
+			break;
 		}
+	}
 
-		inputIdx += codepointLen;
-		matchLen = codepointLen;
+	// The codepoint's bytes are output as-is, reusing the same buffer every time
+	static std::vector<int32_t> codepointUnits;
+	codepointUnits.assign(input.data(), input.data() + codepointLen);
+
+	// Warn if this character is not mapped but any others are
+	if (int firstChar = input[0]; charmap.nodes.size() > 1) {
+		warning(WARNING_UNMAPPED_CHAR_1, "Unmapped character %s", printChar(firstChar));
+	} else if (charmap.name != mainCharmapName) {
+		warning(
+		    WARNING_UNMAPPED_CHAR_2,
+		    "Unmapped character %s not in `%s` charmap",
+		    printChar(firstChar),
+		    mainCharmapName.c_str()
+		);
 	}
 
-	input = input.substr(inputIdx);
-	return matchLen;
+	input = input.substr(codepointLen);
+	return &codepointUnits;
 }
 
 std::string charmap_Reverse(std::vector<int32_t> const &value, bool &unique) {
-	Charmap const &charmap = *currentCharmap;
-	std::string revMapping;
-	unique = forEachChar(charmap, [&](size_t nodeIdx, std::string const &mapping) {
-		if (charmap.nodes[nodeIdx].value == value) {
-			if (revMapping.empty()) {
-				revMapping = mapping;
-			} else {
-				revMapping.clear();
-				return false;
+	Charmap &charmap = *currentCharmap;
+	if (!charmap.isReverseIndexed) {
+		forEachChar(charmap, [&charmap](size_t nodeIdx, std::string const &mapping) {
+			std::vector<int32_t> const &units = charmap.nodes[nodeIdx].value;
+			auto [pos, inserted] = charmap.reverseIndex.try_emplace(units, mapping);
+			if (!inserted) {
+				pos->second = std::nullopt; // Several mappings have this value
 			}
-		}
-		return true;
-	});
-	return revMapping;
+			return true;
+		});
+		charmap.isReverseIndexed = true;
+	}
+
+	auto pos = charmap.reverseIndex.find(value);
+	if (pos == charmap.reverseIndex.end()) {
+		unique = true;
+		return "";
+	}
+	unique = pos->second.has_value();
+	return pos->second.value_or("");
 }
@@ -23,6 +23,7 @@
 #include "itertools.hpp" // reversed
 #include "linkdefs.hpp"
 #include "platform.hpp" // strncasecmp
+#include "profile.hpp"
 #include "verbosity.hpp"
 
 #include "asm/intern.hpp"
@@ -30,6 +31,7 @@
 #include "asm/macro.hpp"
 #include "asm/main.hpp"
 #include "asm/symbol.hpp"
+#include "asm/timeline.hpp"
 #include "asm/warning.hpp"
 
 using namespace std::literals;
@@ -58,6 +60,11 @@ static std::vector<std::string> includePaths = {""}; // -I
 static std::deque<std::string> preIncludeStack;      // -P
 static bool failedOnMissingInclude = false;
 
+// Only opening files is timed; entering macros and loops is too quick to time each of them
+static ProfilePhase fstackPhase("reading files");
+static ProfileCounter nbIncludes("includes");
+static ProfileCounter nbMacroExpansions("macro expansions");
+
 void FileStackNode::printBacktrace(uint32_t curLineNo) const {
 	using TraceItem = std::pair<FileStackNode const *, uint32_t>;
 	std::vector<TraceItem> items;
@@ -254,6 +261,7 @@ bool yywrap() {
 
 	contextStack.pop();
 	contextStack.top().lexerState.setAsCurrentState();
+	timeline_End();
 
 	return false;
 }
@@ -287,6 +295,7 @@ static void newFileContext(std::string const &filePath, bool isQuiet, bool updat
 	});
 
 	context.lexerState.setFileAsNextState(filePath, updateStateNow);
+	timeline_Begin("INCLUDE", fileInfo->name(), fileInfo->parent.get(), fileInfo->lineNo);
 }
 
 static void
@@ -324,10 +333,13 @@ static void
 	});
 
 	context.lexerState.setViewAsNextState("MACRO", macro.getMacro(), macro.fileLine);
+	timeline_Begin("MACRO", macro.name.str(), fileInfo->parent.get(), fileInfo->lineNo);
 }
 
-static Context &
-    newReptContext(int32_t reptLineNo, ContentSpan const &span, uint32_t count, bool isQuiet) {
+// `keyword` is "REPT" or "FOR", to label the loop's trace events
+static Context &newReptContext(
+    char const *keyword, int32_t reptLineNo, ContentSpan const &span, uint32_t count, bool isQuiet
+) {
 	checkRecursionDepth();
 
 	Context &oldContext = contextStack.top();
@@ -350,6 +362,7 @@ static Context &
 	});
 
 	context.lexerState.setViewAsNextState("REPT", span, reptLineNo);
+	timeline_Begin(keyword, keyword, fileInfo->parent.get(), fileInfo->lineNo);
 
 	context.nbReptIters = count;
 
@@ -383,7 +396,9 @@ bool fstk_FailedOnMissingInclude() {
 }
 
 bool fstk_RunInclude(std::string const &path, bool isQuiet) {
+	ProfileScope scope(fstackPhase);
 	if (std::optional<std::string> fullPath = fstk_FindFile(path); fullPath) {
+		++nbIncludes;
 		newFileContext(*fullPath, isQuiet, false);
 		return false;
 	}
@@ -427,13 +442,14 @@ void fstk_RunMacro(InternedStr macroName, std::shared_ptr<MacroArgs> macroArgs,
 	} else if (macro->type != SYM_MACRO) {
 		error("`%s` is not a macro", macroName.c_str());
 	} else {
+		++nbMacroExpansions;
 		newMacroContext(*macro, macroArgs, isQuiet || macro->isQuiet);
 	}
 }
 
 void fstk_RunRept(uint32_t count, int32_t reptLineNo, ContentSpan const &span, bool isQuiet) {
 	if (count) {
-		newReptContext(reptLineNo, span, count, isQuiet);
+		newReptContext("REPT", reptLineNo, span, count, isQuiet);
 	}
 }
 
@@ -469,7 +485,7 @@ void fstk_RunFor(
 		return;
 	}
 
-	Context &context = newReptContext(reptLineNo, span, count, isQuiet);
+	Context &context = newReptContext("FOR", reptLineNo, span, count, isQuiet);
 	context.isForLoop = true;
 	context.forValue = start;
 	context.forStep = step;
@@ -494,6 +510,7 @@ void fstk_NewRecursionDepth(size_t newDepth) {
 }
 
 bool fstk_Init(std::string const &mainPath) {
+	ProfileScope scope(fstackPhase);
 	newFileContext(mainPath, false, true);
 
 	for (std::string const &name : preIncludeStack) {
@@ -11,15 +11,9 @@
 #include <unordered_map>
 
 #include "helpers.hpp" // assume
+#include "util.hpp"    // StringHash
 #include "verbosity.hpp"
 
-// Avoid `std::string` allocations when looking up heterogeneous values in `internedIndexes`
-struct StringHash {
-	using is_transparent = void;
-
-	size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
-};
-
 // Use a `deque` not a `vector` to prevent reallocation so `internedIndexes` keys stay valid
 static std::deque<std::string> internedStrings;
 // Keys are views of values in `internedStrings`; values are their corresponding indexes
@@ -28,6 +28,7 @@
 
 #include "helpers.hpp"
 #include "platform.hpp"
+#include "profile.hpp"
 #include "style.hpp"
 #include "util.hpp"
 #include "verbosity.hpp"
@@ -1288,6 +1289,9 @@ static std::pair<Symbol const *, std::shared_ptr<std::string>> readInterpolation
 		}
 		return {sym, nullptr};
 	} else if (sym->type == SYM_EQUS) {
+		if (!fmt.isParsed()) {
+			return {sym, sym->getEqus()}; // Share the unformatted contents instead of copying them
+		}
 		auto buf = std::make_shared<std::string>();
 		fmt.appendString(*buf, *sym->getEqus());
 		return {sym, buf};
@@ -2275,7 +2279,12 @@ static void verboseOutputString(std::string_view str) {
 }
 // LCOV_EXCL_STOP
 
+// Timing each token would cost more than lexing it, so lexing is counted as part of parsing
+static ProfileCounter nbTokens("tokens");
+
 yy::parser::symbol_type yylex() {
+	++nbTokens;
+
 	if (lexerState->atLineStart && lexerStateEOL) {
 		lexerState = lexerStateEOL;
 		lexerStateEOL = nullptr;
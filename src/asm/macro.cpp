@@ -31,10 +31,15 @@ std::shared_ptr<std::string> MacroArgs::getArg(int32_t num) const {
 }
 
 std::shared_ptr<std::string> MacroArgs::getAllArgs() const {
+	if (allArgs) {
+		return allArgs;
+	}
+
 	size_t nbArgs = args.size();
 
 	if (shift >= nbArgs) {
-		return std::make_shared<std::string>("");
+		allArgs = std::make_shared<std::string>("");
+		return allArgs;
 	}
 
 	size_t len = 0;
@@ -57,6 +62,7 @@ std::shared_ptr<std::string> MacroArgs::getAllArgs() const {
 		}
 	}
 
+	allArgs = str;
 	return str;
 }
 
@@ -65,6 +71,7 @@ void MacroArgs::appendArg(std::shared_ptr<std::string> arg) {
 		warning(WARNING_EMPTY_MACRO_ARG, "Empty macro argument");
 	}
 	args.push_back(arg);
+	allArgs = nullptr;
 }
 
 void MacroArgs::shiftArgs(int32_t count) {
@@ -78,4 +85,5 @@ void MacroArgs::shiftArgs(int32_t count) {
 	} else {
 		shift += count;
 	}
+	allArgs = nullptr;
 }
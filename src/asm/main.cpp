@@ -24,6 +24,7 @@
 #include "helpers.hpp"
 #include "parser.hpp" // Generated from parser.y
 #include "platform.hpp"
+#include "profile.hpp"
 #include "style.hpp" // style_Parse
 #include "usage.hpp"
 #include "util.hpp" // UpperMap
@@ -35,6 +36,7 @@
 #include "asm/output.hpp"
 #include "asm/section.hpp"
 #include "asm/symbol.hpp"
+#include "asm/timeline.hpp"
 #include "asm/warning.hpp"
 
 Options options;
@@ -44,13 +46,15 @@ static struct LocalOptions {
 	std::optional<std::string> dependFileName;                                 // -M
 	std::unordered_map<std::string, std::vector<StateFeature>> stateFileSpecs; // -s
 	std::optional<std::string> inputFileName;                                  // <file>
+	std::optional<std::string> traceEventsFileName;                            // --trace-events
 } localOptions;
 
 // Short options
 static char const *optstring = "B:b:D:Eg:hI:M:o:P:p:Q:r:s:VvW:wX:";
 
 // Long-only option variable
-static int longOpt; // `--color` and variants of `-M`
+// `--color`, `--compact-object`, `--profile`, `--trace-events`, and variants of `-M`
+static int longOpt;
 
 // Equivalent long options
 // Please keep in the same order as short opts.
@@ -79,11 +83,14 @@ static option const longopts[] = {
     {"warning",         required_argument, nullptr,  'W'},
     {"max-errors",      required_argument, nullptr,  'X'},
     {"color",           required_argument, &longOpt, 'c'},
+    {"compact-object",  no_argument,       &longOpt, 'o'},
     {"MC",              no_argument,       &longOpt, 'C'},
     {"MG",              no_argument,       &longOpt, 'G'},
     {"MP",              no_argument,       &longOpt, 'P'},
     {"MQ",              required_argument, &longOpt, 'Q'},
     {"MT",              required_argument, &longOpt, 'T'},
+    {"profile",         required_argument, &longOpt, 'p'},
+    {"trace-events",    required_argument, &longOpt, 'e'},
     {nullptr,           no_argument,       nullptr,  0  },
 };
 
@@ -108,6 +115,8 @@ static Usage usage = {
 };
 // clang-format on
 
+static ProfilePhase parsingPhase("parsing");
+
 static std::string escapeMakeChars(std::string &str) {
 	std::string escaped;
 	size_t pos = 0;
@@ -328,6 +337,10 @@ static void parseArg(int ch, char *arg) {
 			}
 			break;
 
+		case 'o':
+			options.compactObject = true;
+			break;
+
 		case 'C':
 			options.missingIncludeState = GEN_CONTINUE;
 			break;
@@ -354,6 +367,16 @@ static void parseArg(int ch, char *arg) {
 			}
 			break;
 		}
+
+		case 'p':
+			if (!profile_Parse(arg)) {
+				fatal("Invalid argument for option '--profile'");
+			}
+			break;
+
+		case 'e':
+			localOptions.traceEventsFileName = arg;
+			break;
 		}
 		break;
 
@@ -517,6 +540,8 @@ int main(int argc, char *argv[]) {
 		usage.printAndExit("No input file specified (pass \"-\" to read from standard input)");
 	}
 
+	profile_ReportAtExit("rgbasm");
+
 	// LCOV_EXCL_START
 	verbosePrint(
 	    VERB_NOTICE,
@@ -551,12 +576,19 @@ int main(int argc, char *argv[]) {
 
 	charmap_Init();
 
+	if (localOptions.traceEventsFileName) {
+		timeline_Open(*localOptions.traceEventsFileName);
+	}
+
 	// Init lexer and file stack, and parse (`yy::parser` is auto-generated from `parser.y`)
-	if (yy::parser parser; fstk_Init(*localOptions.inputFileName) && parser.parse() != 0) {
+	if (ProfileScope scope(parsingPhase);
+	    fstk_Init(*localOptions.inputFileName) && yy::parser{}.parse() != 0) {
 		// Exited due to YYABORT or YYNOMEM
 		fatal("Unrecoverable error while parsing"); // LCOV_EXCL_LINE
 	}
 
+	timeline_Close();
+
 	// If parse aborted without errors due to a missing INCLUDE, and `-MG` was given, exit normally
 	if (fstk_FailedOnMissingInclude()) {
 		requireZeroErrors();
@@ -7,16 +7,21 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <memory>
+#include <optional>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "helpers.hpp" // assume, Defer
 #include "linkdefs.hpp"
+#include "opmath.hpp"
 #include "platform.hpp"
+#include "profile.hpp"
 #include "util.hpp" // xfclose
 
 #include "asm/charmap.hpp"
@@ -39,22 +44,65 @@ struct Assertion {
 static std::vector<Symbol *> objectSymbols;
 
 static std::deque<Assertion> assertions;
+static std::vector<uint8_t> assertionsRPNPool;
 
 static std::deque<std::shared_ptr<FileStackNode>> fileStackNodes;
 
-static void putLong(uint32_t n, FILE *file) {
-	uint8_t bytes[] = {
-	    static_cast<uint8_t>(n),
-	    static_cast<uint8_t>(n >> 8),
-	    static_cast<uint8_t>(n >> 16),
-	    static_cast<uint8_t>(n >> 24),
-	};
-	fwrite(bytes, 1, sizeof(bytes), file);
+// The whole object file is serialized here, then written at once
+static std::vector<uint8_t> objectBuffer;
+
+// With `--compact-object`, LONGs are varints, and STRINGs are indexes into a table of them
+static bool isCompact = false;
+static std::unordered_map<std::string, uint32_t> stringIDs;
+static std::vector<std::string> stringTable;
+
+static void putByte(uint8_t byte) {
+	objectBuffer.push_back(byte);
+}
+
+static void putFixedLong(uint32_t n) {
+	objectBuffer.insert(
+	    objectBuffer.end(),
+	    {
+	        static_cast<uint8_t>(n),
+	        static_cast<uint8_t>(n >> 8),
+	        static_cast<uint8_t>(n >> 16),
+	        static_cast<uint8_t>(n >> 24),
+	    }
+	);
+}
+
+static void putLong(uint32_t n) {
+	if (!isCompact) {
+		putFixedLong(n);
+		return;
+	}
+	// Unsigned LEB128, 7 bits at a time from the least significant ones
+	for (; n >= 0x80; n >>= 7) {
+		putByte(0x80 | (n & 0x7F));
+	}
+	putByte(n);
+}
+
+static void putBytes(uint8_t const *bytes, size_t size) {
+	objectBuffer.insert(objectBuffer.end(), bytes, bytes + size);
 }
 
-static void putString(std::string const &s, FILE *file) {
-	fputs(s.c_str(), file);
-	putc('\0', file);
+static void putRawString(char const *str) {
+	putBytes(reinterpret_cast<uint8_t const *>(str), strlen(str) + 1); // Including the NUL
+}
+
+static void putString(std::string const &s) {
+	// Strings are NUL-terminated, so they end at their first NUL if they contain any
+	if (!isCompact) {
+		putRawString(s.c_str());
+		return;
+	}
+	auto [pos, inserted] = stringIDs.try_emplace(s.c_str(), stringTable.size());
+	if (inserted) {
+		stringTable.push_back(pos->first);
+	}
+	putLong(pos->second);
 }
 
 void out_RegisterNode(std::shared_ptr<FileStackNode> node) {
@@ -65,63 +113,73 @@ void out_RegisterNode(std::shared_ptr<FileStackNode> node) {
 	}
 }
 
-static void writePatch(Patch const &patch, FILE *file) {
+static void writePatch(Patch const &patch, std::vector<uint8_t> const &rpnPool) {
 	assume(patch.src->ID != UINT32_MAX);
 
-	putLong(patch.src->ID, file);
-	putLong(patch.lineNo, file);
-	putLong(patch.offset, file);
-	putLong(patch.pcSection ? patch.pcSection->getID() : UINT32_MAX, file);
-	putLong(patch.pcOffset, file);
-	putc(patch.type, file);
-	putLong(patch.rpn.size(), file);
-	fwrite(patch.rpn.data(), 1, patch.rpn.size(), file);
+	putLong(patch.src->ID);
+	putLong(patch.lineNo);
+	putLong(patch.offset);
+	putLong(patch.pcSection ? patch.pcSection->getID() : UINT32_MAX);
+	putLong(patch.pcOffset);
+	putByte(patch.type);
+	putLong(patch.rpnSize);
+	putBytes(&rpnPool[patch.rpnOffset], patch.rpnSize);
 }
 
-static void writeSection(Section const &sect, FILE *file) {
+static void writeSection(Section const &sect) {
 	assume(sect.src->ID != UINT32_MAX);
 
-	putString(sect.name, file);
+	putString(sect.name);
 
-	putLong(sect.src->ID, file);
-	putLong(sect.fileLine, file);
+	putLong(sect.src->ID);
+	putLong(sect.fileLine);
 
-	putLong(sect.size, file);
+	putLong(sect.size);
 
 	assume((sect.type & SECTTYPE_TYPE_MASK) == sect.type);
 	bool isUnion = sect.modifier == SECTION_UNION;
 	bool isFragment = sect.modifier == SECTION_FRAGMENT;
-	putc(sect.type | isUnion << SECTTYPE_UNION_BIT | isFragment << SECTTYPE_FRAGMENT_BIT, file);
+	putByte(sect.type | isUnion << SECTTYPE_UNION_BIT | isFragment << SECTTYPE_FRAGMENT_BIT);
 
-	putLong(sect.org, file);
-	putLong(sect.bank, file);
-	putc(sect.align, file);
-	putLong(sect.alignOfs, file);
+	putLong(sect.org);
+	putLong(sect.bank);
+	putByte(sect.align);
+	putLong(sect.alignOfs);
 
 	if (sectTypeHasData(sect.type)) {
-		fwrite(sect.data.data(), 1, sect.size, file);
-		putLong(sect.patches.size(), file);
+		size_t start = objectBuffer.size();
+		putBytes(sect.data.data(), sect.size);
+		putLong(sect.patches.size());
 
 		for (Patch const &patch : sect.patches) {
-			writePatch(patch, file);
+			writePatch(patch, sect.rpnPool);
+		}
+
+		// Compact objects give the size of the data and patches before them, so that RGBLINK
+		// can skip them until they are needed
+		if (isCompact) {
+			size_t end = objectBuffer.size();
+			putLong(end - start);
+			auto begin = objectBuffer.begin();
+			std::rotate(begin + start, begin + end, objectBuffer.end());
 		}
 	}
 }
 
-static void writeSymbol(Symbol const &sym, FILE *file) {
-	putString(sym.name.str(), file);
+static void writeSymbol(Symbol const &sym) {
+	putString(sym.name.str());
 	if (!sym.isDefined()) {
-		putc(SYMTYPE_IMPORT, file);
+		putByte(SYMTYPE_IMPORT);
 	} else {
 		assume(sym.src->ID != UINT32_MAX);
 
 		Section *symSection = sym.getSection();
 
-		putc(sym.isExported ? SYMTYPE_EXPORT : SYMTYPE_LOCAL, file);
-		putLong(sym.src->ID, file);
-		putLong(sym.fileLine, file);
-		putLong(symSection ? symSection->getID() : UINT32_MAX, file);
-		putLong(sym.getOutputValue(), file);
+		putByte(sym.isExported ? SYMTYPE_EXPORT : SYMTYPE_LOCAL);
+		putLong(sym.src->ID);
+		putLong(sym.fileLine);
+		putLong(symSection ? symSection->getID() : UINT32_MAX);
+		putLong(sym.getOutputValue());
 	}
 }
 
@@ -134,7 +192,13 @@ void out_RegisterSymbol(Symbol &sym) {
 	}
 }
 
-static void initPatch(Patch &patch, uint32_t type, Expression const &expr, uint32_t ofs) {
+static void initPatch(
+    Patch &patch,
+    std::vector<uint8_t> &rpnPool,
+    uint32_t type,
+    Expression const &expr,
+    uint32_t ofs
+) {
 	patch.type = type;
 	patch.src = fstk_GetFileStack();
 	// All patches are assumed to eventually be written, so the file stack node is registered
@@ -143,15 +207,18 @@ static void initPatch(Patch &patch, uint32_t type, Expression const &expr, uint3
 	patch.offset = ofs;
 	patch.pcSection = sect_GetSymbolSection();
 	patch.pcOffset = sect_GetSymbolOffset();
-	expr.encode(patch.rpn);
+	patch.rpnOffset = rpnPool.size();
+	expr.encode(rpnPool);
+	patch.rpnSize = rpnPool.size() - patch.rpnOffset;
 }
 
 void out_CreatePatch(uint32_t type, Expression const &expr, uint32_t ofs, uint32_t pcShift) {
 	// Add the patch to the list
-	assume(sect_GetOutputBank().has_value());
-	Patch &patch = *sect_AddOutputPatch();
+	Section *sect = sect_GetOutputSection();
+	assume(sect);
+	Patch &patch = sect->patches.emplace_front();
 
-	initPatch(patch, type, expr, ofs);
+	initPatch(patch, sect->rpnPool, type, expr, ofs);
 
 	// If the patch had a quantity of bytes output before it,
 	// PC is not at the patch's location, but at the location
@@ -164,40 +231,334 @@ void out_CreateAssert(
 ) {
 	Assertion &assertion = assertions.emplace_front();
 
-	initPatch(assertion.patch, type, expr, ofs);
+	initPatch(assertion.patch, assertionsRPNPool, type, expr, ofs);
 	assertion.message = message;
 }
 
-static void writeAssert(Assertion const &assert, FILE *file) {
-	writePatch(assert.patch, file);
-	putString(assert.message, file);
+static ProfileCounter nbFoldedPatches("folded patches");
+
+static Section const *getFixedSection(Section const *sect) {
+	// The offsets of `UNION` and `FRAGMENT` pieces are only known to RGBLINK
+	return sect && sect->org != UINT32_MAX && sect->modifier == SECTION_NORMAL ? sect : nullptr;
+}
+
+// How many values an RPN command pops
+static uint8_t getArity(RPNCommand command) {
+	switch (command) {
+	case RPN_BANK_SYM:
+	case RPN_BANK_SECT:
+	case RPN_BANK_SELF:
+	case RPN_SIZEOF_SECT:
+	case RPN_STARTOF_SECT:
+	case RPN_SIZEOF_SECTTYPE:
+	case RPN_STARTOF_SECTTYPE:
+	case RPN_CONST:
+	case RPN_SYM:
+		return 0;
+	case RPN_NEG:
+	case RPN_NOT:
+	case RPN_LOGNOT:
+	case RPN_HRAM:
+	case RPN_RST:
+	case RPN_BIT_INDEX:
+	case RPN_HIGH:
+	case RPN_LOW:
+	case RPN_BITWIDTH:
+	case RPN_TZCOUNT:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+static uint32_t readLong(uint8_t const *&ptr) {
+	uint32_t value = ptr[0] | ptr[1] << 8 | ptr[2] << 16 | static_cast<uint32_t>(ptr[3]) << 24;
+	ptr += 4;
+	return value;
 }
 
-static void writeFileStackNode(FileStackNode const &node, FILE *file) {
-	putLong(node.parent ? node.parent->ID : UINT32_MAX, file);
-	putLong(node.lineNo, file);
+// Computes a patch's value the same way RGBLINK would, but only if it depends on nothing that
+// RGBLINK could change, and if RGBLINK would not report anything about it
+static std::optional<int32_t> tryComputePatch(Patch const &patch, uint8_t const *rpn) {
+	static std::vector<uint32_t> stack; // `static` to reuse its allocation
+	stack.clear();
+	auto pop = []() {
+		assume(!stack.empty());
+		uint32_t value = stack.back();
+		stack.pop_back();
+		return value;
+	};
+
+	for (uint8_t const *end = rpn + patch.rpnSize; rpn != end;) {
+		RPNCommand command = static_cast<RPNCommand>(*rpn++);
 
-	putc(node.type | node.isQuiet << FSTACKNODE_QUIET_BIT, file);
+		// Unsigned, so that arithmetic wraps around without UB
+		uint8_t arity = getArity(command);
+		uint32_t rval = arity >= 1 ? pop() : 0;
+		uint32_t lval = arity >= 2 ? pop() : 0;
+		int32_t srval = rval, slval = lval;
+
+		int32_t value;
+		switch (command) {
+		case RPN_ADD:
+			value = lval + rval;
+			break;
+		case RPN_SUB:
+			value = lval - rval;
+			break;
+		case RPN_MUL:
+			value = lval * rval;
+			break;
+		case RPN_DIV:
+			if (srval == 0 || (slval == INT32_MIN && srval == -1)) {
+				return std::nullopt;
+			}
+			value = op_divide(slval, srval);
+			break;
+		case RPN_MOD:
+			if (srval == 0 || (slval == INT32_MIN && srval == -1)) {
+				return std::nullopt;
+			}
+			value = op_modulo(slval, srval);
+			break;
+		case RPN_NEG:
+			value = op_neg(srval);
+			break;
+		case RPN_EXP:
+			if (srval < 0) {
+				return std::nullopt;
+			}
+			value = op_exponent(slval, srval);
+			break;
+		case RPN_HIGH:
+			value = op_high(srval);
+			break;
+		case RPN_LOW:
+			value = op_low(srval);
+			break;
+		case RPN_BITWIDTH:
+			value = op_bitwidth(srval);
+			break;
+		case RPN_TZCOUNT:
+			value = op_tzcount(srval);
+			break;
+		case RPN_OR:
+			value = lval | rval;
+			break;
+		case RPN_AND:
+			value = lval & rval;
+			break;
+		case RPN_XOR:
+			value = lval ^ rval;
+			break;
+		case RPN_NOT:
+			value = ~rval;
+			break;
+		case RPN_LOGAND:
+			value = lval && rval;
+			break;
+		case RPN_LOGOR:
+			value = lval || rval;
+			break;
+		case RPN_LOGNOT:
+			value = !rval;
+			break;
+		case RPN_LOGEQ:
+			value = slval == srval;
+			break;
+		case RPN_LOGNE:
+			value = slval != srval;
+			break;
+		case RPN_LOGGT:
+			value = slval > srval;
+			break;
+		case RPN_LOGLT:
+			value = slval < srval;
+			break;
+		case RPN_LOGGE:
+			value = slval >= srval;
+			break;
+		case RPN_LOGLE:
+			value = slval <= srval;
+			break;
+		case RPN_SHL:
+			if (srval < 0 || srval >= 32) {
+				return std::nullopt;
+			}
+			value = op_shift_left(slval, srval);
+			break;
+		case RPN_SHR:
+			if (slval < 0 || srval < 0 || srval >= 32) {
+				return std::nullopt;
+			}
+			value = op_shift_right(slval, srval);
+			break;
+		case RPN_USHR:
+			if (srval < 0 || srval >= 32) {
+				return std::nullopt;
+			}
+			value = op_shift_right_unsigned(slval, srval);
+			break;
+
+		case RPN_HRAM:
+			if (srval < 0xFF00 || srval > 0xFFFF) {
+				return std::nullopt;
+			}
+			value = srval & 0xFF;
+			break;
+		case RPN_RST:
+			if (srval & ~0x38) {
+				return std::nullopt;
+			}
+			value = srval | 0xC7;
+			break;
+		case RPN_BIT_INDEX:
+			if (srval & ~0x07) {
+				return std::nullopt;
+			}
+			value = *rpn++ | srval << 3;
+			break;
+
+		case RPN_CONST:
+			value = readLong(rpn);
+			break;
+
+		case RPN_SYM:
+			if (uint32_t symID = readLong(rpn); symID == UINT32_MAX) { // PC
+				Section const *sect = getFixedSection(patch.pcSection);
+				if (!sect) {
+					return std::nullopt;
+				}
+				value = sect->org + patch.pcOffset;
+			} else if (Symbol const *sym = objectSymbols[symID];
+			           sym->type == SYM_EQU || sym->type == SYM_VAR
+			           || (sym->type == SYM_LABEL && getFixedSection(sym->getSection()))) {
+				value = sym->getValue();
+			} else {
+				return std::nullopt; // Imported from another object, or relocatable
+			}
+			break;
+
+		case RPN_BANK_SYM: {
+			Symbol const *sym = objectSymbols[readLong(rpn)];
+			Section const *sect = sym->type == SYM_LABEL ? sym->getSection() : nullptr;
+			if (!sect || sect->bank == UINT32_MAX) {
+				return std::nullopt;
+			}
+			value = sect->bank;
+			break;
+		}
+		case RPN_BANK_SELF:
+			if (!patch.pcSection || patch.pcSection->bank == UINT32_MAX) {
+				return std::nullopt;
+			}
+			value = patch.pcSection->bank;
+			break;
+
+		// Sections may be merged with other objects' ones, and section types' sizes and starts
+		// depend on RGBLINK's options
+		default:
+			return std::nullopt;
+		}
+
+		stack.push_back(value);
+	}
+
+	assume(stack.size() == 1);
+	return static_cast<int32_t>(stack.back());
+}
+
+// Writes a patch's value into its section's data, if it can already be computed
+static bool tryFoldPatch(Section &sect, Patch const &patch) {
+	std::optional<int32_t> value = tryComputePatch(patch, &sect.rpnPool[patch.rpnOffset]);
+	if (!value) {
+		return false;
+	}
+
+	// These checks must match `applyFilePatches` in RGBLINK
+	switch (patch.type) {
+	case PATCHTYPE_BYTE:
+		if (*value < -0x80 || *value > 0xFF) {
+			return false;
+		}
+		sect.data[patch.offset] = *value & 0xFF;
+		break;
+
+	case PATCHTYPE_WORD:
+		if (*value < -0x8000 || *value > 0xFFFF) {
+			return false;
+		}
+		sect.data[patch.offset] = *value & 0xFF;
+		sect.data[patch.offset + 1] = *value >> 8;
+		break;
+
+	case PATCHTYPE_LONG:
+		for (uint8_t i = 0; i < 4; ++i) {
+			sect.data[patch.offset + i] = *value >> (i * 8);
+		}
+		break;
+
+	case PATCHTYPE_JR: {
+		Section const *pcSection = getFixedSection(patch.pcSection);
+		if (!pcSection || *value < -0x8000 || *value > 0xFFFF) {
+			return false;
+		}
+		// Offset is relative to the byte *after* the operand
+		uint16_t address = pcSection->org + patch.pcOffset + 2;
+		int16_t jumpOffset = static_cast<int16_t>(*value - address);
+		if (jumpOffset < -128 || jumpOffset > 127) {
+			return false;
+		}
+		sect.data[patch.offset] = jumpOffset & 0xFF;
+		break;
+	}
+
+	default:
+		return false;
+	}
+
+	++nbFoldedPatches;
+	return true;
+}
+
+// Patches whose value got known after they were created need not be left to RGBLINK
+static void foldPatches(Section &sect) {
+	std::erase_if(sect.patches, [&sect](Patch const &patch) { return tryFoldPatch(sect, patch); });
+}
+
+static void writeAssert(Assertion const &assert) {
+	writePatch(assert.patch, assertionsRPNPool);
+	putString(assert.message);
+}
+
+static void writeFileStackNode(FileStackNode const &node) {
+	putLong(node.parent ? node.parent->ID : UINT32_MAX);
+	putLong(node.lineNo);
+
+	putByte(node.type | node.isQuiet << FSTACKNODE_QUIET_BIT);
 
 	if (node.type != NODE_REPT) {
-		putString(node.name(), file);
+		putString(node.name());
 	} else {
 		std::vector<uint32_t> const &nodeIters = node.iters();
 
-		putLong(nodeIters.size(), file);
+		putLong(nodeIters.size());
 		// Iters are stored by decreasing depth, so reverse the order for output
 		for (uint32_t iter : reversed(nodeIters)) {
-			putLong(iter, file);
+			putLong(iter);
 		}
 	}
 }
 
+static ProfilePhase outputPhase("output");
+
 void out_WriteObject() {
 	if (!options.objectFileName) {
 		return;
 	}
+	ProfileScope scope(outputPhase);
 
-	static FILE *file; // `static` so `sect_ForEach` callback can see it
+	FILE *file;
 	char const *objectFileName = options.objectFileName->c_str();
 	if (*options.objectFileName != "-") {
 		file = fopen(objectFileName, "wb");
@@ -211,35 +572,61 @@ void out_WriteObject() {
 		fatal("Failed to open object file \"%s\": %s", objectFileName, strerror(errno));
 		// LCOV_EXCL_STOP
 	}
-	Defer closeFile{[&] { xfclose(file); }};
+
+	sect_ForEach(foldPatches);
 
 	// Also write symbols that weren't written above
 	sym_ForEach(out_RegisterSymbol);
 
-	fputs(RGBDS_OBJECT_VERSION_STRING, file);
-	putLong(RGBDS_OBJECT_REV, file);
+	objectBuffer.clear();
+	isCompact = options.compactObject;
 
-	putLong(objectSymbols.size(), file);
-	putLong(sect_CountSections(), file);
+	putLong(objectSymbols.size());
+	putLong(sect_CountSections());
 
-	putLong(fileStackNodes.size(), file);
+	putLong(fileStackNodes.size());
 	for (auto it = fileStackNodes.begin(); it != fileStackNodes.end(); ++it) {
-		writeFileStackNode(**it, file);
+		writeFileStackNode(**it);
 
 		// The list is supposed to have decrementing IDs
 		assume(it + 1 == fileStackNodes.end() || it[1]->ID == it[0]->ID - 1);
 	}
 
 	for (Symbol const *sym : objectSymbols) {
-		writeSymbol(*sym, file);
+		writeSymbol(*sym);
 	}
 
-	sect_ForEach([](Section &sect) { writeSection(sect, file); });
+	sect_ForEach([](Section &sect) { writeSection(sect); });
 
-	putLong(assertions.size(), file);
+	putLong(assertions.size());
 
 	for (Assertion const &assert : assertions) {
-		writeAssert(assert, file);
+		writeAssert(assert);
+	}
+
+	// The header comes last, since the string table is only complete now
+	std::vector<uint8_t> body = std::move(objectBuffer);
+	objectBuffer.clear();
+	putBytes(
+	    reinterpret_cast<uint8_t const *>(RGBDS_OBJECT_VERSION_STRING),
+	    literal_strlen(RGBDS_OBJECT_VERSION_STRING)
+	);
+	// The revision is always a fixed LONG, since it determines how everything after it is read
+	putFixedLong(isCompact ? RGBDS_OBJECT_REV_COMPACT : RGBDS_OBJECT_REV);
+	if (isCompact) {
+		putLong(stringTable.size());
+		for (std::string const &str : stringTable) {
+			putRawString(str.c_str());
+		}
+	}
+
+	// Buffered writes may only fail when flushed, and errors have already been counted by now
+	if (fwrite(objectBuffer.data(), 1, objectBuffer.size(), file) != objectBuffer.size()
+	    || fwrite(body.data(), 1, body.size(), file) != body.size() || fflush(file) != 0
+	    || xfclose(file) != 0) {
+		// LCOV_EXCL_START
+		fatal("Failed to write object file \"%s\": %s", objectFileName, strerror(errno));
+		// LCOV_EXCL_STOP
 	}
 }
 
@@ -375,6 +762,7 @@ static bool dumpMacros(FILE *file) {
 }
 
 void out_WriteState(std::string name, std::vector<StateFeature> const &features) {
+	ProfileScope scope(outputPhase);
 	// State files may include macro bodies, which may contain arbitrary characters,
 	// so output as binary to preserve them.
 	FILE *file;
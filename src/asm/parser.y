@@ -1156,8 +1156,7 @@ constlist_8bit_entry:
 		sect_RelByte($1, 0);
 	}
 	| string_literal {
-		std::vector<int32_t> output = charmap_Convert($1);
-		sect_ByteString(output);
+		sect_ByteString($1);
 	}
 	| scoped_sym {
 		handleSymbolByType(
@@ -1166,10 +1165,7 @@ constlist_8bit_entry:
 			    expr.checkNBit(8);
 			    sect_RelByte(expr, 0);
 		    },
-		    [](std::string const &str) {
-			    std::vector<int32_t> output = charmap_Convert(str);
-			    sect_ByteString(output);
-		    }
+		    [](std::string const &str) { sect_ByteString(str); }
 		);
 	}
 ;
@@ -1185,8 +1181,7 @@ constlist_16bit_entry:
 		sect_RelWord($1, 0);
 	}
 	| string_literal {
-		std::vector<int32_t> output = charmap_Convert($1);
-		sect_WordString(output);
+		sect_WordString($1);
 	}
 	| scoped_sym {
 		handleSymbolByType(
@@ -1195,10 +1190,7 @@ constlist_16bit_entry:
 			    expr.checkNBit(16);
 			    sect_RelWord(expr, 0);
 		    },
-		    [](std::string const &str) {
-			    std::vector<int32_t> output = charmap_Convert(str);
-			    sect_WordString(output);
-		    }
+		    [](std::string const &str) { sect_WordString(str); }
 		);
 	}
 	| fragment_literal {
@@ -1219,17 +1211,13 @@ constlist_32bit_entry:
 		sect_RelLong($1, 0);
 	}
 	| string_literal {
-		std::vector<int32_t> output = charmap_Convert($1);
-		sect_LongString(output);
+		sect_LongString($1);
 	}
 	| scoped_sym {
 		handleSymbolByType(
 		    $1,
 		    [](Expression const &expr) { sect_RelLong(expr, 0); },
-		    [](std::string const &str) {
-			    std::vector<int32_t> output = charmap_Convert(str);
-			    sect_LongString(output);
-		    }
+		    [](std::string const &str) { sect_LongString(str); }
 		);
 	}
 ;
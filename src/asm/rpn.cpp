@@ -25,19 +25,78 @@
 
 using namespace std::literals;
 
+std::string UnknownReason::format() const {
+	std::string reason;
+	switch (kind) {
+	case PC_VALUE:
+		reason = "PC is not constant at assembly time";
+		break;
+	case SYM_VALUE:
+		reason = "`"s + name.str() + "` is not constant at assembly time";
+		break;
+	case SYM_UNDEFINED:
+		reason = "undefined symbol `"s + name.str() + "`";
+		break;
+	case PC_BANK:
+		reason = "Current section's bank is not known";
+		break;
+	case SYM_BANK:
+		reason = "`"s + name.str() + "`'s bank is not known";
+		break;
+	case SECT_BANK:
+		reason = "Section \""s + name.str() + "\"'s bank is not known";
+		break;
+	case SECT_SIZE:
+		reason = "Section \""s + name.str() + "\"'s size is not known";
+		break;
+	case SECT_START:
+		reason = "Section \""s + name.str() + "\"'s start is not known";
+		break;
+	case SECTTYPE_SIZE:
+		reason = "Section type's size is not known";
+		break;
+	case SECTTYPE_START:
+		reason = "Section type's start is not known";
+		break;
+	}
+	if (wasPurged) {
+		reason += "; it was purged";
+	}
+	return reason;
+}
+
 int32_t Expression::getConstVal() const {
 	if (!isKnown()) {
-		error("Expected constant expression: %s", std::get<std::string>(data).c_str());
+		error("Expected constant expression: %s", std::get<UnknownReason>(data).format().c_str());
 		return 0;
 	}
 	return value();
 }
 
+static void appendLong(std::vector<uint8_t> &buffer, uint32_t value) {
+	buffer.push_back(value & 0xFF);
+	buffer.push_back(value >> 8);
+	buffer.push_back(value >> 16);
+	buffer.push_back(value >> 24);
+}
+
+static void appendName(std::vector<uint8_t> &rpn, RPNCommand command, InternedStr name) {
+	assume(name.getIndex() <= UINT32_MAX);
+	rpn.push_back(command);
+	appendLong(rpn, name.getIndex());
+}
+
+static InternedStr readName(uint8_t const *bytes) {
+	return InternedStr(
+	    bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24
+	);
+}
+
 Symbol const *Expression::symbolOf() const {
-	if (rpn.size() != 1 || rpn[0].command != RPN_SYM) {
+	if (rpn.size() != 5 || rpn[0] != RPN_SYM) {
 		return nullptr;
 	}
-	return sym_FindScopedSymbol(std::get<InternedStr>(rpn[0].data));
+	return sym_FindScopedSymbol(readName(&rpn[1]));
 }
 
 bool Expression::isDiffConstant(Symbol const *sym) const {
@@ -67,13 +126,18 @@ void Expression::makeSymbol(InternedStr symName) {
 		error("`%s` is not a numeric symbol", symName.c_str());
 		data = 0;
 	} else if (!sym || !sym->isConstant()) {
-		data = sym_IsPC(sym) ? "PC is not constant at assembly time"
-		                     : (sym && sym->isDefined()
-		                            ? "`"s + symName.str() + "` is not constant at assembly time"
-		                            : "undefined symbol `"s + symName.str() + "`")
-		                           + (sym_IsPurgedScoped(symName) ? "; it was purged" : "");
+		if (sym_IsPC(sym)) {
+			data = UnknownReason{.kind = UnknownReason::PC_VALUE};
+		} else {
+			data = UnknownReason{
+			    .kind = sym && sym->isDefined() ? UnknownReason::SYM_VALUE
+			                                    : UnknownReason::SYM_UNDEFINED,
+			    .wasPurged = sym_IsPurgedScoped(symName),
+			    .name = symName,
+			};
+		}
 		sym = sym_Ref(symName);
-		rpn.emplace_back(RPN_SYM, sym->name);
+		appendName(rpn, RPN_SYM, sym->name);
 	} else {
 		data = static_cast<int32_t>(sym->getConstantValue());
 	}
@@ -87,8 +151,8 @@ void Expression::makeBankSymbol(InternedStr symName) {
 			error("PC has no bank outside of a section");
 			data = 1;
 		} else if (*outputBank == UINT32_MAX) {
-			data = "Current section's bank is not known";
-			rpn.emplace_back(RPN_BANK_SELF);
+			data = UnknownReason{.kind = UnknownReason::PC_BANK};
+			rpn.push_back(RPN_BANK_SELF);
 		} else {
 			data = static_cast<int32_t>(*outputBank);
 		}
@@ -102,10 +166,12 @@ void Expression::makeBankSymbol(InternedStr symName) {
 			// Symbol's section is known and bank is fixed
 			data = static_cast<int32_t>(sym->getSection()->bank);
 		} else {
-			data = sym_IsPurgedScoped(symName)
-			           ? "`"s + symName.str() + "`'s bank is not known; it was purged"
-			           : "`"s + symName.str() + "`'s bank is not known";
-			rpn.emplace_back(RPN_BANK_SYM, sym->name);
+			data = UnknownReason{
+			    .kind = UnknownReason::SYM_BANK,
+			    .wasPurged = sym_IsPurgedScoped(symName),
+			    .name = symName,
+			};
+			appendName(rpn, RPN_BANK_SYM, sym->name);
 		}
 	}
 }
@@ -115,8 +181,9 @@ void Expression::makeBankSection(std::string const &sectName) {
 	if (Section *sect = sect_FindSectionByName(sectName); sect && sect->bank != UINT32_MAX) {
 		data = static_cast<int32_t>(sect->bank);
 	} else {
-		data = "Section \""s + sectName + "\"'s bank is not known";
-		rpn.emplace_back(RPN_BANK_SECT, intern(sectName));
+		InternedStr name = intern(sectName);
+		data = UnknownReason{.kind = UnknownReason::SECT_BANK, .name = name};
+		appendName(rpn, RPN_BANK_SECT, name);
 	}
 }
 
@@ -125,8 +192,9 @@ void Expression::makeSizeOfSection(std::string const &sectName) {
 	if (Section *sect = sect_FindSectionByName(sectName); sect && sect->isSizeKnown()) {
 		data = static_cast<int32_t>(sect->size);
 	} else {
-		data = "Section \""s + sectName + "\"'s size is not known";
-		rpn.emplace_back(RPN_SIZEOF_SECT, intern(sectName));
+		InternedStr name = intern(sectName);
+		data = UnknownReason{.kind = UnknownReason::SECT_SIZE, .name = name};
+		appendName(rpn, RPN_SIZEOF_SECT, name);
 	}
 }
 
@@ -135,21 +203,24 @@ void Expression::makeStartOfSection(std::string const &sectName) {
 	if (Section *sect = sect_FindSectionByName(sectName); sect && sect->org != UINT32_MAX) {
 		data = static_cast<int32_t>(sect->org);
 	} else {
-		data = "Section \""s + sectName + "\"'s start is not known";
-		rpn.emplace_back(RPN_STARTOF_SECT, intern(sectName));
+		InternedStr name = intern(sectName);
+		data = UnknownReason{.kind = UnknownReason::SECT_START, .name = name};
+		appendName(rpn, RPN_STARTOF_SECT, name);
 	}
 }
 
 void Expression::makeSizeOfSectionType(SectionType type) {
 	assume(rpn.empty());
-	data = "Section type's size is not known";
-	rpn.emplace_back(RPN_SIZEOF_SECTTYPE, static_cast<uint8_t>(type));
+	data = UnknownReason{.kind = UnknownReason::SECTTYPE_SIZE};
+	rpn.push_back(RPN_SIZEOF_SECTTYPE);
+	rpn.push_back(type);
 }
 
 void Expression::makeStartOfSectionType(SectionType type) {
 	assume(rpn.empty());
-	data = "Section type's start is not known";
-	rpn.emplace_back(RPN_STARTOF_SECTTYPE, static_cast<uint8_t>(type));
+	data = UnknownReason{.kind = UnknownReason::SECTTYPE_START};
+	rpn.push_back(RPN_STARTOF_SECTTYPE);
+	rpn.push_back(type);
 }
 
 static bool tryConstZero(Expression const &lhs, Expression const &rhs) {
@@ -287,7 +358,7 @@ void Expression::makeUnaryOp(RPNCommand op, Expression &&src) {
 		// If it's not known, just reuse its RPN vector and append the operator
 		data = std::move(src.data);
 		std::swap(rpn, src.rpn);
-		rpn.emplace_back(op);
+		rpn.push_back(op);
 	}
 }
 
@@ -425,7 +496,8 @@ void Expression::makeBinaryOp(RPNCommand op, Expression &&src1, Expression const
 			uint32_t lval = src1.value();
 			// Use the other expression's un-const reason
 			data = std::move(src2.data);
-			rpn.emplace_back(RPN_CONST, lval);
+			rpn.push_back(RPN_CONST);
+			appendLong(rpn, lval);
 		} else {
 			// Otherwise just reuse its RPN vector
 			data = std::move(src1.data);
@@ -436,19 +508,20 @@ void Expression::makeBinaryOp(RPNCommand op, Expression &&src1, Expression const
 		if (src2.isKnown()) {
 			// If the right expression is constant, append its value
 			uint32_t rval = src2.value();
-			rpn.emplace_back(RPN_CONST, rval);
+			rpn.push_back(RPN_CONST);
+			appendLong(rpn, rval);
 		} else {
 			// Otherwise just extend with its RPN vector
 			rpn.insert(rpn.end(), RANGE(src2.rpn));
 		}
 		// Append the operator
-		rpn.emplace_back(op);
+		rpn.push_back(op);
 	}
 }
 
 void Expression::addCheckHRAM() {
 	if (!isKnown()) {
-		rpn.emplace_back(RPN_HRAM);
+		rpn.push_back(RPN_HRAM);
 	} else if (int32_t val = value(); val >= 0xFF00 && val <= 0xFFFF) {
 		// That range is valid; only keep the lower byte
 		data = val & 0xFF;
@@ -459,7 +532,7 @@ void Expression::addCheckHRAM() {
 
 void Expression::addCheckRST() {
 	if (!isKnown()) {
-		rpn.emplace_back(RPN_RST);
+		rpn.push_back(RPN_RST);
 	} else if (int32_t val = value(); val & ~0x38) {
 		// A valid RST address must be masked with 0x38
 		error("Invalid address $%" PRIx32 " for `RST`", val);
@@ -469,7 +542,8 @@ void Expression::addCheckRST() {
 void Expression::addCheckBitIndex(uint8_t mask) {
 	assume((mask & 0xC0) != 0x00); // The high two bits must correspond to BIT, RES, or SET
 	if (!isKnown()) {
-		rpn.emplace_back(RPN_BIT_INDEX, mask);
+		rpn.push_back(RPN_BIT_INDEX);
+		rpn.push_back(mask);
 	} else if (int32_t val = value(); val & ~0x07) {
 		// A valid bit index must be masked with 0x07
 		static char const *instructions[4] = {"instruction", "`BIT`", "`RES`", "`SET`"};
@@ -513,102 +587,57 @@ bool checkNBit(int32_t v, uint8_t n, char const *name) {
 }
 
 void Expression::encode(std::vector<uint8_t> &buffer) const {
-	assume(buffer.empty());
-
 	if (isKnown()) {
 		// If the RPN expression's value is known, output a constant directly
-		uint32_t val = value();
-		buffer.resize(5);
-		buffer[0] = RPN_CONST;
-		buffer[1] = val & 0xFF;
-		buffer[2] = val >> 8;
-		buffer[3] = val >> 16;
-		buffer[4] = val >> 24;
-	} else {
-		// If the RPN expression's value is not known, serialize its RPN values
-		buffer.reserve(rpn.size() * 2); // Rough estimate of the serialized size
-		for (RPNValue const &val : rpn) {
-			val.appendEncoded(buffer);
-		}
+		buffer.push_back(RPN_CONST);
+		appendLong(buffer, value());
+		return;
 	}
-}
 
-RPNValue::RPNValue(RPNCommand cmd) : command(cmd), data(std::monostate{}) {
-	assume(
-	    cmd != RPN_SIZEOF_SECTTYPE && cmd != RPN_STARTOF_SECTTYPE && cmd != RPN_BIT_INDEX
-	    && cmd != RPN_CONST && cmd != RPN_SYM && cmd != RPN_BANK_SYM && cmd != RPN_BANK_SECT
-	    && cmd != RPN_SIZEOF_SECT && cmd != RPN_STARTOF_SECT
-	);
-}
-
-RPNValue::RPNValue(RPNCommand cmd, uint8_t val) : command(cmd), data(val) {
-	assume(cmd == RPN_SIZEOF_SECTTYPE || cmd == RPN_STARTOF_SECTTYPE || cmd == RPN_BIT_INDEX);
-}
+	// Otherwise, copy its RPN bytes, resolving the names that they refer to
+	for (size_t i = 0; i < rpn.size();) {
+		RPNCommand command = static_cast<RPNCommand>(rpn[i++]);
+		buffer.push_back(command);
 
-RPNValue::RPNValue(RPNCommand cmd, uint32_t val) : command(cmd), data(val) {
-	assume(cmd == RPN_CONST);
-}
-
-RPNValue::RPNValue(RPNCommand cmd, InternedStr name) : command(cmd), data(name) {
-	assume(
-	    cmd == RPN_SYM || cmd == RPN_BANK_SYM || cmd == RPN_BANK_SECT || cmd == RPN_SIZEOF_SECT
-	    || cmd == RPN_STARTOF_SECT
-	);
-}
-
-void RPNValue::appendEncoded(std::vector<uint8_t> &buffer) const {
-	// Every command starts with its own ID
-	buffer.push_back(command);
-
-	switch (command) {
-	case RPN_CONST: {
-		// The command ID is followed by a four-byte integer
-		assume(std::holds_alternative<uint32_t>(data));
-		uint32_t val = std::get<uint32_t>(data);
-		buffer.push_back(val & 0xFF);
-		buffer.push_back(val >> 8);
-		buffer.push_back(val >> 16);
-		buffer.push_back(val >> 24);
-		break;
-	}
+		switch (command) {
+		case RPN_CONST:
+			// The command ID is followed by a four-byte integer
+			buffer.insert(buffer.end(), &rpn[i], &rpn[i + 4]);
+			i += 4;
+			break;
 
-	case RPN_SYM:
-	case RPN_BANK_SYM: {
-		// The command ID is followed by a four-byte symbol ID
-		assume(std::holds_alternative<InternedStr>(data));
-		// The symbol name is always written expanded
-		Symbol *sym = sym_FindExactSymbol(std::get<InternedStr>(data));
-		out_RegisterSymbol(*sym); // Ensure that `sym->ID` is set
-		buffer.push_back(sym->ID & 0xFF);
-		buffer.push_back(sym->ID >> 8);
-		buffer.push_back(sym->ID >> 16);
-		buffer.push_back(sym->ID >> 24);
-		break;
-	}
+		case RPN_SYM:
+		case RPN_BANK_SYM: {
+			// The command ID is followed by a four-byte symbol ID
+			// The symbol name is always written expanded
+			Symbol *sym = sym_FindExactSymbol(readName(&rpn[i]));
+			out_RegisterSymbol(*sym); // Ensure that `sym->ID` is set
+			appendLong(buffer, sym->ID);
+			i += 4;
+			break;
+		}
 
-	case RPN_BANK_SECT:
-	case RPN_SIZEOF_SECT:
-	case RPN_STARTOF_SECT: {
-		// The command ID is followed by a NUL-terminated section name string
-		assume(std::holds_alternative<InternedStr>(data));
-		std::string const &name = std::get<InternedStr>(data).str();
-		buffer.reserve(buffer.size() + name.length() + 1);
-		buffer.insert(buffer.end(), RANGE(name));
-		buffer.push_back('\0');
-		break;
-	}
+		case RPN_BANK_SECT:
+		case RPN_SIZEOF_SECT:
+		case RPN_STARTOF_SECT: {
+			// The command ID is followed by a NUL-terminated section name string
+			std::string const &name = readName(&rpn[i]).str();
+			buffer.insert(buffer.end(), RANGE(name));
+			buffer.push_back('\0');
+			i += 4;
+			break;
+		}
 
-	case RPN_SIZEOF_SECTTYPE:
-	case RPN_STARTOF_SECTTYPE:
-	case RPN_BIT_INDEX:
-		// The command ID is followed by a byte value
-		assume(std::holds_alternative<uint8_t>(data));
-		buffer.push_back(std::get<uint8_t>(data));
-		break;
+		case RPN_SIZEOF_SECTTYPE:
+		case RPN_STARTOF_SECTTYPE:
+		case RPN_BIT_INDEX:
+			// The command ID is followed by a byte value
+			buffer.push_back(rpn[i++]);
+			break;
 
-	default:
-		// Other command IDs are not followed by anything
-		assume(std::holds_alternative<std::monostate>(data));
-		break;
+		default:
+			// Other command IDs are not followed by anything
+			break;
+		}
 	}
 }
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -24,12 +25,14 @@
 #include "platform.hpp" // fseek
 #include "util.hpp"     // xfclose, seekSize
 
+#include "asm/charmap.hpp"
 #include "asm/fstack.hpp"
 #include "asm/lexer.hpp"
 #include "asm/main.hpp"
 #include "asm/output.hpp"
 #include "asm/rpn.hpp"
 #include "asm/symbol.hpp"
+#include "asm/timeline.hpp"
 #include "asm/warning.hpp"
 
 using namespace std::literals;
@@ -640,8 +643,8 @@ std::optional<uint32_t> sect_GetOutputBank() {
 	return currentSection ? std::optional<uint32_t>(currentSection->bank) : std::nullopt;
 }
 
-Patch *sect_AddOutputPatch() {
-	return currentSection ? &currentSection->patches.emplace_front() : nullptr;
+Section *sect_GetOutputSection() {
+	return currentSection;
 }
 
 // Returns how many bytes need outputting for the specified alignment and offset to succeed
@@ -735,16 +738,44 @@ static void writeByte(uint8_t byte) {
 	growSection(1);
 }
 
+// Writes `size` bytes at once, growing the section only once
+static void writeBytes(uint8_t const *bytes, uint32_t size) {
+	std::vector<uint8_t> &data = currentSection->data;
+	if (uint32_t index = sect_GetOutputOffset(); index < data.size()) {
+		std::copy_n(bytes, std::min<size_t>(size, data.size() - index), &data[index]);
+	}
+	growSection(size);
+}
+
+// Writes `size` bytes repeating `pattern`, growing the section only once
+static void fillBytes(uint8_t const *pattern, size_t patternSize, uint32_t size) {
+	std::vector<uint8_t> &data = currentSection->data;
+	if (uint32_t index = sect_GetOutputOffset(); index < data.size()) {
+		size_t fillSize = std::min<size_t>(size, data.size() - index);
+		if (patternSize == 1) {
+			std::fill_n(&data[index], fillSize, *pattern);
+		} else {
+			for (size_t i = 0; i < fillSize; ++i) {
+				data[index + i] = pattern[i % patternSize];
+			}
+		}
+	}
+	growSection(size);
+}
+
 static void writeWord(uint16_t value) {
-	writeByte(value & 0xFF);
-	writeByte(value >> 8);
+	uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+	writeBytes(bytes, sizeof(bytes));
 }
 
 static void writeLong(uint32_t value) {
-	writeByte(value & 0xFF);
-	writeByte(value >> 8);
-	writeByte(value >> 16);
-	writeByte(value >> 24);
+	uint8_t bytes[4] = {
+	    static_cast<uint8_t>(value),
+	    static_cast<uint8_t>(value >> 8),
+	    static_cast<uint8_t>(value >> 16),
+	    static_cast<uint8_t>(value >> 24),
+	};
+	writeBytes(bytes, sizeof(bytes));
 }
 
 static void createPatch(PatchType type, Expression const &expr, uint32_t pcShift) {
@@ -811,46 +842,54 @@ void sect_ConstByte(uint8_t byte) {
 	writeByte(byte);
 }
 
-void sect_ByteString(std::vector<int32_t> const &str) {
-	if (!requireCodeSection()) {
-		return;
-	}
-
-	for (int32_t unit : str) {
-		if (!checkNBit(unit, 8, "All character units")) {
-			break;
+// Converts a string with the current charmap, and outputs each of its units as `unitSize` bytes
+// as soon as they are converted. The diagnostics are the same as converting the whole string
+// first: any from the charmap, then the section's, then only the first unit that does not fit.
+static void writeString(std::string const &str, uint8_t unitSize) {
+	bool hasData = currentSection && sectTypeHasData(currentSection->type);
+	uint8_t nbBits = unitSize * 8;
+	std::optional<int32_t> badUnit;
+	// The units are written in place, and the section only grows once they all are
+	size_t startIndex = hasData ? sect_GetOutputOffset() : 0, index = startIndex;
+
+	std::string_view view = str;
+	for (std::vector<int32_t> const *units; (units = charmap_ConvertNextUnits(view));) {
+		if (!hasData) {
+			continue; // Still convert, for the charmap's diagnostics
+		}
+		std::vector<uint8_t> &data = currentSection->data;
+		for (int32_t unit : *units) {
+			if (unitSize != 4 && !badUnit
+			    && (unit < -(1 << (nbBits - 1)) || unit >= 1 << nbBits)) {
+				badUnit = unit;
+			}
+			for (uint8_t i = 0; i < unitSize; ++i, ++index) {
+				if (index < data.size()) {
+					data[index] = static_cast<uint32_t>(unit) >> (i * 8);
+				}
+			}
 		}
 	}
 
-	for (int32_t unit : str) {
-		writeByte(static_cast<uint8_t>(unit));
-	}
-}
-
-void sect_WordString(std::vector<int32_t> const &str) {
 	if (!requireCodeSection()) {
 		return;
 	}
-
-	for (int32_t unit : str) {
-		if (!checkNBit(unit, 16, "All character units")) {
-			break;
-		}
+	growSection(index - startIndex);
+	if (badUnit) {
+		checkNBit(*badUnit, nbBits, "All character units");
 	}
+}
 
-	for (int32_t unit : str) {
-		writeWord(static_cast<uint16_t>(unit));
-	}
+void sect_ByteString(std::string const &str) {
+	writeString(str, 1);
 }
 
-void sect_LongString(std::vector<int32_t> const &str) {
-	if (!requireCodeSection()) {
-		return;
-	}
+void sect_WordString(std::string const &str) {
+	writeString(str, 2);
+}
 
-	for (int32_t unit : str) {
-		writeLong(static_cast<uint32_t>(unit));
-	}
+void sect_LongString(std::string const &str) {
+	writeString(str, 4);
 }
 
 void sect_Skip(uint32_t skip, bool ds) {
@@ -871,9 +910,7 @@ void sect_Skip(uint32_t skip, bool ds) {
 			);
 		}
 		// We know we're in a code SECTION
-		while (skip--) {
-			writeByte(options.padByte);
-		}
+		fillBytes(&options.padByte, 1, skip);
 	}
 }
 
@@ -895,12 +932,33 @@ void sect_RelBytes(uint32_t n, std::vector<Expression> const &exprs) {
 		return;
 	}
 
-	for (uint32_t i = 0; i < n; ++i) {
-		if (Expression const &expr = exprs[i % exprs.size()]; !expr.isKnown()) {
-			createPatch(PATCHTYPE_BYTE, expr, i);
-			writeByte(0);
+	std::vector<uint8_t> pattern(exprs.size());
+	bool isConstant = true;
+	for (size_t i = 0; i < exprs.size(); ++i) {
+		if (exprs[i].isKnown()) {
+			pattern[i] = exprs[i].value();
 		} else {
-			writeByte(expr.value());
+			isConstant = false;
+		}
+	}
+	if (isConstant) {
+		fillBytes(pattern.data(), pattern.size(), n);
+		return;
+	}
+
+	// Runs of constant bytes are written at once, and only the others need patches
+	for (uint32_t i = 0; i < n;) {
+		size_t start = i % exprs.size(), end = start;
+		while (end < exprs.size() && exprs[end].isKnown() && i + (end - start) < n) {
+			++end;
+		}
+		if (end != start) {
+			writeBytes(&pattern[start], end - start);
+			i += end - start;
+		} else {
+			createPatch(PATCHTYPE_BYTE, exprs[start], i);
+			writeByte(0);
+			++i;
 		}
 	}
 }
@@ -969,6 +1027,7 @@ bool sect_BinaryFile(std::string const &name, uint32_t startPos) {
 		return false;
 	}
 
+	TimelineSpan span("INCBIN", name);
 	FILE *file = nullptr;
 	if (std::optional<std::string> fullPath = fstk_FindFile(name); fullPath) {
 		file = fopen(fullPath->c_str(), "rb");
@@ -1010,8 +1069,9 @@ bool sect_BinaryFile(std::string const &name, uint32_t startPos) {
 		// LCOV_EXCL_STOP
 	}
 
-	for (int byte; (byte = fgetc(file)) != EOF;) {
-		writeByte(byte);
+	uint8_t buffer[4096];
+	for (size_t nbRead; (nbRead = fread(buffer, 1, sizeof(buffer), file)) != 0;) {
+		writeBytes(buffer, nbRead);
 	}
 
 	if (ferror(file)) {
@@ -1030,6 +1090,7 @@ bool sect_BinaryFileSlice(std::string const &name, uint32_t startPos, uint32_t l
 		return false;
 	}
 
+	TimelineSpan span("INCBIN", name);
 	FILE *file = nullptr;
 	if (std::optional<std::string> fullPath = fstk_FindFile(name); fullPath) {
 		file = fopen(fullPath->c_str(), "rb");
@@ -1081,20 +1142,27 @@ bool sect_BinaryFileSlice(std::string const &name, uint32_t startPos, uint32_t l
 		// LCOV_EXCL_STOP
 	}
 
-	while (length--) {
-		if (int byte = fgetc(file); byte != EOF) {
-			writeByte(byte);
-			// LCOV_EXCL_START
-		} else if (ferror(file)) {
+	uint8_t buffer[4096];
+	while (length) {
+		size_t nbWanted = std::min<size_t>(length, sizeof(buffer));
+		size_t nbRead = fread(buffer, 1, nbWanted, file);
+		writeBytes(buffer, nbRead);
+		length -= nbRead;
+		if (nbRead == nbWanted) {
+			continue;
+		}
+		// LCOV_EXCL_START
+		if (ferror(file)) {
 			error("Error reading `INCBIN` file \"%s\": %s", name.c_str(), strerror(errno));
 		} else {
 			error(
 			    "Premature end of `INCBIN` file \"%s\" (%" PRId32 " bytes left to read)",
 			    name.c_str(),
-			    length + 1
+			    length
 			);
-			// LCOV_EXCL_STOP
 		}
+		break;
+		// LCOV_EXCL_STOP
 	}
 	return false;
 }
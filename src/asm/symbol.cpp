@@ -375,7 +375,8 @@ bool sym_IsPurgedExact(InternedStr symName) {
 }
 
 bool sym_IsPurgedScoped(InternedStr symName) {
-	return sym_IsPurgedExact(expandedSymName(symName));
+	// Most programs never purge anything, so avoid expanding the name for nothing
+	return !purgedSymbols.empty() && sym_IsPurgedExact(expandedSymName(symName));
 }
 
 int32_t sym_GetRSValue() {
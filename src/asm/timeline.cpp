@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: MIT
+
+#include "asm/timeline.hpp"
+
+#include <chrono>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+
+#include "helpers.hpp" // assume
+#include "linkdefs.hpp"
+
+#include "asm/fstack.hpp"
+#include "asm/lexer.hpp"
+#include "asm/warning.hpp"
+
+static FILE *file = nullptr;
+static std::chrono::steady_clock::time_point startTime;
+static uint32_t depth = 0; // How many spans are open
+static bool isFirstEvent = true;
+
+void timeline_Open(std::string const &path) {
+	file = fopen(path.c_str(), "w");
+	if (!file) {
+		fatal("Failed to open trace events file \"%s\": %s", path.c_str(), strerror(errno));
+	}
+	// Events are written as they happen, so buffer them generously
+	setvbuf(file, nullptr, _IOFBF, 1 << 16);
+	startTime = std::chrono::steady_clock::now();
+
+	// This is the "JSON Array Format", whose closing bracket may be missing if assembly aborts
+	fputc('[', file);
+}
+
+static void beginEvent(char phase) {
+	using Microseconds = std::chrono::duration<double, std::micro>;
+	double ts = Microseconds(std::chrono::steady_clock::now() - startTime).count();
+	fprintf(
+	    file,
+	    "%s\n{\"ph\": \"%c\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f",
+	    isFirstEvent ? "" : ",",
+	    phase,
+	    ts
+	);
+	isFirstEvent = false;
+}
+
+static void putString(std::string_view str) {
+	fputc('"', file);
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+			fputc(c, file);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			fprintf(file, "\\u%04x", c);
+		} else {
+			fputc(c, file);
+		}
+	}
+	fputc('"', file);
+}
+
+void timeline_Begin(
+    char const *category, std::string_view name, FileStackNode const *node, uint32_t lineNo
+) {
+	if (!file) {
+		return;
+	}
+
+	// REPT nodes have no name of their own, so use the file or macro that they are in
+	while (node && node->type == NODE_REPT) {
+		node = node->parent.get();
+	}
+
+	beginEvent('B');
+	fprintf(file, ", \"cat\": \"%s\", \"name\": ", category);
+	putString(name);
+	if (node) {
+		fputs(", \"args\": {\"node\": ", file);
+		putString(node->name());
+		fprintf(file, ", \"line\": %" PRIu32 "}", lineNo);
+	}
+	fputc('}', file);
+	++depth;
+}
+
+void timeline_End() {
+	if (!file) {
+		return;
+	}
+
+	assume(depth != 0);
+	beginEvent('E');
+	fputc('}', file);
+	--depth;
+}
+
+void timeline_Close() {
+	if (!file) {
+		return;
+	}
+
+	while (depth != 0) {
+		timeline_End();
+	}
+	fputs("\n]\n", file);
+	if (fclose(file) != 0) {
+		// LCOV_EXCL_START
+		error("Failed to write trace events: %s", strerror(errno));
+		// LCOV_EXCL_STOP
+	}
+	file = nullptr;
+}
+
+TimelineSpan::TimelineSpan(char const *category, std::string const &name) {
+	if (!file) {
+		return;
+	}
+
+	timeline_Begin(category, name, fstk_GetFileStack().get(), lexer_GetLineNo());
+	_isOpen = true;
+}
+
+TimelineSpan::~TimelineSpan() {
+	if (_isOpen) {
+		timeline_End();
+	}
+}
@@ -3,6 +3,7 @@
 #include "fix/fix.hpp"
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
@@ -15,6 +16,7 @@
 #include "diagnostics.hpp"
 #include "helpers.hpp"
 #include "platform.hpp"
+#include "romheader.hpp"
 #include "util.hpp" // xclose, xfclose
 
 #include "fix/main.hpp"
@@ -23,6 +25,13 @@
 
 static constexpr off_t BANK_SIZE = 0x4000;
 
+// To keep file sizes fairly reasonable, we'll cap the amount of banks at 65536.
+// Official mappers only go up to 512 banks, but at least the TPP1 spec allows up to
+// 65536 banks = 1 GiB.
+// This should be reasonable for the time being, and may be extended later.
+static constexpr off_t NB_BANKS_LIMIT = 0x10000;
+static_assert(NB_BANKS_LIMIT * BANK_SIZE <= SSIZE_MAX, "Max input file size too large for OS");
+
 static ssize_t readBytes(int fd, uint8_t *buf, size_t len) {
 	// POSIX specifies that lengths greater than SSIZE_MAX yield implementation-defined results
 	assume(len <= SSIZE_MAX);
@@ -75,85 +84,25 @@ static ssize_t writeBytes(int fd, uint8_t *buf, size_t len) {
 	return total;
 }
 
-static void overwriteByte(uint8_t *rom0, uint16_t addr, uint8_t fixedByte, char const *areaName) {
-	uint8_t origByte = rom0[addr];
-
-	if (origByte != 0 && origByte != fixedByte) {
-		warning(WARNING_OVERWRITE, "Overwrote a non-zero byte in the %s", areaName);
-	}
-
-	rom0[addr] = fixedByte;
-}
-
-static void overwriteBytes(
-    uint8_t *rom0, uint16_t startAddr, uint8_t const *fixed, uint8_t size, char const *areaName
-) {
-	for (uint8_t i = 0; i < size; ++i) {
-		uint8_t origByte = rom0[i + startAddr];
-
-		if (origByte != 0 && origByte != fixed[i]) {
-			warning(WARNING_OVERWRITE, "Overwrote a non-zero byte in the %s", areaName);
-			break;
-		}
-	}
-
-	memcpy(&rom0[startAddr], fixed, size);
+static void warnOverwrite(char const *fieldName) {
+	warning(WARNING_OVERWRITE, "Overwrote a non-zero byte in the %s", fieldName);
 }
 
-static void
-    processFile(int input, int output, char const *name, off_t fileSize, bool expectFileSize) {
-	if (expectFileSize) {
-		assume(fileSize != 0);
-	} else {
-		assume(fileSize == 0);
-	}
-
-	uint8_t rom0[BANK_SIZE];
-	ssize_t rom0Len = readBytes(input, rom0, sizeof(rom0));
-	// Also used as how many bytes to write back when fixing in-place
-	ssize_t headerSize = (options.cartridgeType & 0xFF00) == TPP1 ? 0x154 : 0x150;
-
-	if (rom0Len == -1) {
-		// LCOV_EXCL_START
-		error("Failed to read \"%s\"'s header: %s", name, strerror(errno));
-		return;
-		// LCOV_EXCL_STOP
-	} else if (rom0Len < headerSize) {
-		error(
-		    "\"%s\" too short, expected at least %jd ($%jx) bytes, got only %jd",
-		    name,
-		    static_cast<intmax_t>(headerSize),
-		    static_cast<intmax_t>(headerSize),
-		    static_cast<intmax_t>(rom0Len)
-		);
-		return;
-	}
-	// Accept partial reads if the file contains at least the header
+// Writes every header field that does not depend on the rest of the ROM
+static void overwriteHeader(uint8_t *rom0) {
+	HeaderWriter header(rom0, warnOverwrite);
 
 	if (options.fixSpec & (FIX_LOGO | TRASH_LOGO)) {
-		overwriteBytes(
-		    rom0,
-		    0x0104,
-		    options.logo,
-		    sizeof(options.logo),
-		    options.logoFilename ? "logo" : "Nintendo logo"
-		);
+		header.writeLogo(options.logo, options.logoFilename ? "logo" : "Nintendo logo");
 	}
 
 	if (options.title) {
-		overwriteBytes(
-		    rom0,
-		    0x134,
-		    reinterpret_cast<uint8_t const *>(options.title->c_str()),
-		    options.titleLen,
-		    "title"
-		);
+		header.writeTitle(*options.title, options.titleLen);
 	}
 
 	if (options.gameID) {
-		overwriteBytes(
-		    rom0,
-		    0x13F,
+		header.writeBytes(
+		    HEADER_MANUFACTURER,
 		    reinterpret_cast<uint8_t const *>(options.gameID->c_str()),
 		    options.gameIDLen,
 		    "manufacturer code"
@@ -161,13 +110,12 @@ static void
 	}
 
 	if (options.model != DMG) {
-		overwriteByte(rom0, 0x143, options.model == BOTH ? 0x80 : 0xC0, "CGB flag");
+		header.writeByte(HEADER_CGB_FLAG, options.model == BOTH ? 0x80 : 0xC0, "CGB flag");
 	}
 
 	if (options.newLicensee) {
-		overwriteBytes(
-		    rom0,
-		    0x144,
+		header.writeBytes(
+		    HEADER_NEW_LICENSEE,
 		    reinterpret_cast<uint8_t const *>(options.newLicensee->c_str()),
 		    options.newLicenseeLen,
 		    "new licensee code"
@@ -175,7 +123,7 @@ static void
 	}
 
 	if (options.sgb) {
-		overwriteByte(rom0, 0x146, 0x03, "SGB flag");
+		header.writeByte(HEADER_SGB_FLAG, 0x03, "SGB flag");
 	}
 
 	// If a valid MBC was specified...
@@ -187,7 +135,7 @@ static void
 			byte = 0xBC;
 			// The other TPP1 identification bytes will be written below
 		}
-		overwriteByte(rom0, 0x147, byte, "cartridge type");
+		header.writeCartridgeType(byte);
 	}
 
 	// ROM size will be written last, after evaluating the file's size
@@ -195,53 +143,94 @@ static void
 	if ((options.cartridgeType & 0xFF00) == TPP1) {
 		uint8_t const tpp1Code[2] = {0xC1, 0x65};
 
-		overwriteBytes(rom0, 0x149, tpp1Code, sizeof(tpp1Code), "TPP1 identification code");
+		header.writeBytes(0x149, tpp1Code, sizeof(tpp1Code), "TPP1 identification code");
 
-		overwriteBytes(
-		    rom0, 0x150, options.tpp1Rev, sizeof(options.tpp1Rev), "TPP1 revision number"
-		);
+		header.writeBytes(0x150, options.tpp1Rev, sizeof(options.tpp1Rev), "TPP1 revision number");
 
 		if (options.ramSize != UNSPECIFIED) {
-			overwriteByte(rom0, 0x152, options.ramSize, "RAM size");
+			header.writeByte(0x152, options.ramSize, "RAM size");
 		}
 
-		overwriteByte(rom0, 0x153, options.cartridgeType & 0xFF, "TPP1 feature flags");
+		header.writeByte(0x153, options.cartridgeType & 0xFF, "TPP1 feature flags");
 	} else {
 		// Regular mappers
 
 		if (options.ramSize != UNSPECIFIED) {
-			overwriteByte(rom0, 0x149, options.ramSize, "RAM size");
+			header.writeByte(HEADER_RAM_SIZE, options.ramSize, "RAM size");
 		}
 
 		if (!options.japanese) {
-			overwriteByte(rom0, 0x14A, 0x01, "destination code");
+			header.writeByte(HEADER_DESTINATION, 0x01, "destination code");
 		}
 	}
 
 	if (options.oldLicensee != UNSPECIFIED) {
-		overwriteByte(rom0, 0x14B, options.oldLicensee, "old licensee code");
-	} else if (options.sgb && rom0[0x14B] != 0x33) {
+		header.writeByte(HEADER_OLD_LICENSEE, options.oldLicensee, "old licensee code");
+	} else if (options.sgb && rom0[HEADER_OLD_LICENSEE] != 0x33) {
 		warning(
 		    WARNING_SGB,
 		    "SGB compatibility enabled, but old licensee was 0x%02x, not 0x33",
-		    rom0[0x14B]
+		    rom0[HEADER_OLD_LICENSEE]
 		);
 	}
 
 	if (options.romVersion != UNSPECIFIED) {
-		overwriteByte(rom0, 0x14C, options.romVersion, "mask ROM version number");
+		header.writeByte(HEADER_ROM_VERSION, options.romVersion, "mask ROM version number");
+	}
+}
+
+// Handles the header checksum after the ROM size has been written, then the global checksum.
+// `romxSum` is the sum of all bytes past ROM0, including any padding.
+static void fixChecksums(uint8_t *rom0, size_t rom0Len, uint16_t romxSum) {
+	HeaderWriter header(rom0, warnOverwrite);
+
+	if (options.fixSpec & (FIX_HEADER_SUM | TRASH_HEADER_SUM)) {
+		header.writeChecksum(options.fixSpec & TRASH_HEADER_SUM);
+	}
+
+	if (options.fixSpec & (FIX_GLOBAL_SUM | TRASH_GLOBAL_SUM)) {
+		header.writeGlobalChecksum(rom0Len, romxSum, options.fixSpec & TRASH_GLOBAL_SUM);
+	}
+}
+
+static void
+    processFile(int input, int output, char const *name, off_t fileSize, bool expectFileSize) {
+	if (expectFileSize) {
+		assume(fileSize != 0);
+	} else {
+		assume(fileSize == 0);
+	}
+
+	uint8_t rom0[BANK_SIZE];
+	ssize_t rom0Len = readBytes(input, rom0, sizeof(rom0));
+	// Also used as how many bytes to write back when fixing in-place
+	ssize_t headerSize = (options.cartridgeType & 0xFF00) == TPP1 ? 0x154 : HEADER_END;
+
+	if (rom0Len == -1) {
+		// LCOV_EXCL_START
+		error("Failed to read \"%s\"'s header: %s", name, strerror(errno));
+		return;
+		// LCOV_EXCL_STOP
+	} else if (rom0Len < headerSize) {
+		error(
+		    "\"%s\" too short, expected at least %jd ($%jx) bytes, got only %jd",
+		    name,
+		    static_cast<intmax_t>(headerSize),
+		    static_cast<intmax_t>(headerSize),
+		    static_cast<intmax_t>(rom0Len)
+		);
+		return;
 	}
+	// Accept partial reads if the file contains at least the header
+
+	overwriteHeader(rom0);
 
 	// Remain to be handled the ROM size, and header checksum.
 	// The latter depends on the former, and so will be handled after it.
 	// The former requires knowledge of the file's total size, so read that first.
 
-	uint16_t globalSum = 0;
+	uint16_t romxSum = 0;
 
-	// To keep file sizes fairly reasonable, we'll cap the amount of banks at 65536.
-	// Official mappers only go up to 512 banks, but at least the TPP1 spec allows up to
-	// 65536 banks = 1 GiB.
-	// This should be reasonable for the time being, and may be extended later.
 	std::vector<uint8_t> romx; // Buffer of ROMX bank data
 	uint32_t nbBanks = 1;      // Number of banks *targeted*, including ROM0
 	size_t totalRomxLen = 0;   // *Actual* size of ROMX data
@@ -250,8 +239,6 @@ static void
 	auto errorTooLarge = [&name]() {
 		error("\"%s\" has more than 65536 banks", name); // LCOV_EXCL_LINE
 	};
-	static constexpr off_t NB_BANKS_LIMIT = 0x10000;
-	static_assert(NB_BANKS_LIMIT * BANK_SIZE <= SSIZE_MAX, "Max input file size too large for OS");
 	if (input == output) {
 		if (fileSize >= NB_BANKS_LIMIT * BANK_SIZE) {
 			return errorTooLarge(); // LCOV_EXCL_LINE
@@ -260,10 +247,20 @@ static void
 		nbBanks = (fileSize + (BANK_SIZE - 1)) / BANK_SIZE; // ceil(fileSize / BANK_SIZE)
 		totalRomxLen = fileSize >= BANK_SIZE ? fileSize - BANK_SIZE : 0;
 	} else if (rom0Len == BANK_SIZE) {
+		// If the input's size is known, avoid growing the buffer bank by bank
+		if (expectFileSize && fileSize > BANK_SIZE) {
+			romx.reserve(std::min(fileSize, NB_BANKS_LIMIT * BANK_SIZE) - BANK_SIZE);
+		}
 		// Copy ROMX when reading a pipe, and we're not at EOF yet
 		for (;;) {
 			romx.resize(nbBanks * BANK_SIZE);
 			ssize_t bankLen = readBytes(input, &romx[(nbBanks - 1) * BANK_SIZE], BANK_SIZE);
+			if (bankLen == -1) {
+				// LCOV_EXCL_START
+				error("Failed to read \"%s\"'s ROMX: %s", name, strerror(errno));
+				return;
+				// LCOV_EXCL_STOP
+			}
 			// Update bank count, ONLY IF at least one byte was read
 			if (bankLen) {
 				// We're going to read another bank, check that it won't be too much
@@ -272,9 +269,7 @@ static void
 				}
 				++nbBanks;
 				// Update global checksum, too
-				for (uint16_t i = 0; i < bankLen; ++i) {
-					globalSum += romx[totalRomxLen + i];
-				}
+				romxSum += header_SumBytes(&romx[totalRomxLen], bankLen);
 				totalRomxLen += bankLen;
 			}
 			// Stop when an incomplete bank has been read
@@ -285,85 +280,44 @@ static void
 	}
 
 	// Handle setting the ROM size if padding was requested
-	// Pad to the next valid power of 2. This is because padding is required by flashers, which
-	// flash to ROM chips, whose size is always a power of 2... so there'd be no point in
-	// padding to something else.
-	// Additionally, a ROM must be at least 32k, so we guarantee a whole amount of banks...
 	if (options.padValue != UNSPECIFIED) {
-		// We want at least 2 banks
-		if (nbBanks == 1) {
-			if (rom0Len != sizeof(rom0)) {
-				memset(&rom0[rom0Len], options.padValue, sizeof(rom0) - rom0Len);
-				// The global checksum hasn't taken ROM0 into consideration yet!
-				// ROM0 was padded, so treat it as entirely written: update its size
-				// Update how many bytes were read in total, too
-				rom0Len = sizeof(rom0);
-			}
-			nbBanks = 2;
-		} else {
-			assume(rom0Len == sizeof(rom0));
+		if (nbBanks == 1 && rom0Len != sizeof(rom0)) {
+			memset(&rom0[rom0Len], options.padValue, sizeof(rom0) - rom0Len);
+			// The global checksum hasn't taken ROM0 into consideration yet!
+			// ROM0 was padded, so treat it as entirely written: update its size
+			// Update how many bytes were read in total, too
+			rom0Len = sizeof(rom0);
 		}
-		assume(nbBanks >= 2);
+		assume(rom0Len == sizeof(rom0));
 		// Alter number of banks to reflect required value
-		// x&(x-1) is zero iff x is a power of 2, or 0; we know for sure it's non-zero,
-		// so this is true (non-zero) when we don't have a power of 2
-		if (nbBanks & (nbBanks - 1)) {
-			nbBanks = 1 << (CHAR_BIT * sizeof(nbBanks) - clz(nbBanks));
-		}
+		nbBanks = header_PaddedNbBanks(nbBanks);
 		// Write final ROM size
-		rom0[0x148] = ctz(nbBanks / 2);
+		rom0[HEADER_ROM_SIZE] = header_RomSizeCode(nbBanks);
 		// Alter global checksum based on how many bytes will be added (not counting ROM0)
-		globalSum += options.padValue * ((nbBanks - 1) * BANK_SIZE - totalRomxLen);
-	}
-
-	// Handle the header checksum after the ROM size has been written
-	if (options.fixSpec & (FIX_HEADER_SUM | TRASH_HEADER_SUM)) {
-		uint8_t sum = 0;
-
-		for (uint16_t i = 0x134; i < 0x14D; ++i) {
-			sum -= rom0[i] + 1;
-		}
-
-		overwriteByte(
-		    rom0, 0x14D, options.fixSpec & TRASH_HEADER_SUM ? ~sum : sum, "header checksum"
-		);
+		romxSum += options.padValue * ((nbBanks - 1) * BANK_SIZE - totalRomxLen);
 	}
 
-	if (options.fixSpec & (FIX_GLOBAL_SUM | TRASH_GLOBAL_SUM)) {
-		// Computation of the global checksum does not include the checksum bytes
-		assume(rom0Len >= 0x14E);
-		for (uint16_t i = 0; i < 0x14E; ++i) {
-			globalSum += rom0[i];
-		}
-		for (uint16_t i = 0x150; i < rom0Len; ++i) {
-			globalSum += rom0[i];
-		}
-		// Pipes have already read ROMX and updated globalSum, but not regular files
-		if (input == output) {
-			for (;;) {
-				uint8_t bank[BANK_SIZE];
-				ssize_t bankLen = readBytes(input, bank, sizeof(bank));
-
-				for (uint16_t i = 0; i < bankLen; ++i) {
-					globalSum += bank[i];
-				}
-				if (bankLen != sizeof(bank)) {
-					break;
-				}
+	// Pipes have already read ROMX and updated the checksum, but not regular files
+	if (input == output && (options.fixSpec & (FIX_GLOBAL_SUM | TRASH_GLOBAL_SUM))) {
+		for (;;) {
+			uint8_t bank[BANK_SIZE];
+			ssize_t bankLen = readBytes(input, bank, sizeof(bank));
+			if (bankLen == -1) {
+				// LCOV_EXCL_START
+				error("Failed to read \"%s\"'s ROMX: %s", name, strerror(errno));
+				return;
+				// LCOV_EXCL_STOP
 			}
-		}
 
-		if (options.fixSpec & TRASH_GLOBAL_SUM) {
-			globalSum = ~globalSum;
+			romxSum += header_SumBytes(bank, bankLen);
+			if (bankLen != sizeof(bank)) {
+				break;
+			}
 		}
-
-		uint8_t bytes[2] = {
-		    static_cast<uint8_t>(globalSum >> 8), static_cast<uint8_t>(globalSum & 0xFF)
-		};
-
-		overwriteBytes(rom0, 0x14E, bytes, sizeof(bytes), "global checksum");
 	}
 
+	fixChecksums(rom0, rom0Len, romxSum);
+
 	ssize_t writeLen;
 
 	// In case the output depends on the input, reset to the beginning of the file, and only
@@ -455,8 +409,92 @@ static void
 	}
 }
 
-bool fix_ProcessFile(char const *name, char const *outputName) {
-	warnings.nbErrors = 0;
+#if HAVE_MMAP
+// Fixes a regular file in-place by mapping it, so that reading it does not copy it around, and
+// only the pages containing the header (and the padding, if any) get written back.
+// Returns false if the file could not be mapped, in which case it has not been modified.
+static bool processMappedFile(int fd, char const *name, off_t fileSize) {
+	ssize_t headerSize = (options.cartridgeType & 0xFF00) == TPP1 ? 0x154 : HEADER_END;
+	if (fileSize < headerSize) {
+		error(
+		    "\"%s\" too short, expected at least %jd ($%jx) bytes, got only %jd",
+		    name,
+		    static_cast<intmax_t>(headerSize),
+		    static_cast<intmax_t>(headerSize),
+		    static_cast<intmax_t>(fileSize)
+		);
+		return true;
+	}
+	if (fileSize >= NB_BANKS_LIMIT * BANK_SIZE) {
+		error("\"%s\" has more than 65536 banks", name); // LCOV_EXCL_LINE
+		return true;                                      // LCOV_EXCL_LINE
+	}
+
+	off_t romSize = fileSize;
+	uint32_t nbBanks = (fileSize + (BANK_SIZE - 1)) / BANK_SIZE; // ceil(fileSize / BANK_SIZE)
+	if (options.padValue != UNSPECIFIED) {
+		nbBanks = header_PaddedNbBanks(nbBanks);
+		romSize = nbBanks * BANK_SIZE;
+	}
+
+	// The padding is written before mapping the file, so that running out of space is reported
+	// as an error, instead of raising `SIGBUS` when writing through the mapping
+	if (romSize != fileSize) {
+		if (lseek(fd, fileSize, SEEK_SET) == static_cast<off_t>(-1)) {
+			return false; // LCOV_EXCL_LINE
+		}
+		uint8_t bank[BANK_SIZE];
+		memset(bank, options.padValue, sizeof(bank));
+		for (off_t len = romSize - fileSize; len;) {
+			size_t thisLen = len > BANK_SIZE ? BANK_SIZE : len;
+			if (static_cast<size_t>(writeBytes(fd, bank, thisLen)) != thisLen) {
+				// LCOV_EXCL_START
+				error("Failed to write \"%s\"'s padding: %s", name, strerror(errno));
+				(void)ftruncate(fd, fileSize);
+				return true;
+				// LCOV_EXCL_STOP
+			}
+			len -= thisLen;
+		}
+	}
+
+	void *mapping = mmap(nullptr, romSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapping == MAP_FAILED) {
+		// LCOV_EXCL_START
+		// Let the slower path pad the file again, from the beginning
+		if (romSize != fileSize
+		    && (ftruncate(fd, fileSize) == -1
+		        || lseek(fd, 0, SEEK_SET) == static_cast<off_t>(-1))) {
+			error("Failed to restore \"%s\"'s size: %s", name, strerror(errno));
+			return true;
+		}
+		return false;
+		// LCOV_EXCL_STOP
+	}
+	Defer unmap{[&] { munmap(mapping, romSize); }};
+	uint8_t *rom = static_cast<uint8_t *>(mapping);
+
+	overwriteHeader(rom);
+
+	if (options.padValue != UNSPECIFIED) {
+		// Write final ROM size
+		rom[HEADER_ROM_SIZE] = header_RomSizeCode(nbBanks);
+	}
+
+	// Only read ROMX if the global checksum needs it
+	uint16_t romxSum = 0;
+	if (romSize > BANK_SIZE && (options.fixSpec & (FIX_GLOBAL_SUM | TRASH_GLOBAL_SUM))) {
+		romxSum = header_SumBytes(&rom[BANK_SIZE], romSize - BANK_SIZE);
+	}
+	fixChecksums(rom, std::min(romSize, BANK_SIZE), romxSum);
+
+	return true;
+}
+#endif
+
+bool fix_ProcessFile(char const *name, char const *outputName, FileDiagnostics &diags) {
+	setFileDiagnostics(&diags);
+	Defer resetDiags{[] { setFileDiagnostics(nullptr); }};
 
 	bool inputStdin = !strcmp(name, "-");
 	if (inputStdin && !outputName) {
@@ -504,7 +542,7 @@ bool fix_ProcessFile(char const *name, char const *outputName) {
 			// LCOV_EXCL_START
 			error("\"%s\" is not a regular file, and thus cannot be modified in-place", name);
 			// LCOV_EXCL_STOP
-		} else if (stat.st_size < 0x150) {
+		} else if (stat.st_size < HEADER_END) {
 			// This check is in theory redundant with the one in `processFile`, but it
 			// prevents passing a file size of 0, which usually indicates pipes
 			error(
@@ -512,11 +550,16 @@ bool fix_ProcessFile(char const *name, char const *outputName) {
 			    name,
 			    static_cast<intmax_t>(stat.st_size)
 			);
+		} else if (outputName) {
+			processFile(input, output, name, stat.st_size, true);
 		} else {
-			if (!outputName) {
-				output = input;
+#if HAVE_MMAP
+			// Mapping the file is much faster for large ROMs, but it may not always be possible
+			if (processMappedFile(input, name, stat.st_size)) {
+				return checkErrors(name);
 			}
-			processFile(input, output, name, stat.st_size, true);
+#endif
+			processFile(input, input, name, stat.st_size, true);
 		}
 	}
 
@@ -2,20 +2,28 @@
 
 #include "fix/main.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <mutex>
 #include <optional>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "cli.hpp"
 #include "diagnostics.hpp"
 #include "helpers.hpp"
 #include "platform.hpp"
+#include "romheader.hpp" // header_MaxTitleLen, nintendoLogo
 #include "style.hpp"
 #include "usage.hpp"
 #include "util.hpp"
@@ -28,6 +36,7 @@ Options options;
 
 // Flags which must be processed after the option parsing finishes
 static struct LocalOptions {
+	uint32_t nbJobs = 1;                       // --jobs; 0 means one per CPU core
 	std::optional<std::string> outputFileName; // -o
 	std::vector<std::string> inputFileNames;   // <file>...
 } localOptions;
@@ -36,7 +45,7 @@ static struct LocalOptions {
 static char const *optstring = "Ccf:hi:jk:L:l:m:n:Oo:p:r:st:VvW:w";
 
 // Long-only option variable
-static int longOpt; // `--color`
+static int longOpt; // `--color`, `--jobs`
 
 // Equivalent long options
 // Please keep in the same order as short opts.
@@ -67,6 +76,7 @@ static option const longopts[] = {
     {"validate",         no_argument,       nullptr,  'v'},
     {"warning",          required_argument, nullptr,  'W'},
     {"color",            required_argument, &longOpt, 'c'},
+    {"jobs",             required_argument, &longOpt, 'j'},
     {nullptr,            no_argument,       nullptr,  0  },
 };
 
@@ -106,17 +116,29 @@ static uint16_t parseByte(char const *input, char name) {
 	}
 }
 
+// The title has less room if the header also has a manufacturer code or a CGB flag
+static void setTitleLen(size_t len) {
+	uint8_t maxLen = header_MaxTitleLen(options.gameID.has_value(), options.model != DMG);
+
+	if (len > maxLen) {
+		len = maxLen;
+		warning(
+		    WARNING_TRUNCATION,
+		    "Truncating title \"%s\" to %u chars",
+		    options.title->c_str(),
+		    maxLen
+		);
+	}
+	options.titleLen = len;
+}
+
 static void parseArg(int ch, char *arg) {
 	switch (ch) {
 	case 'C':
 	case 'c':
 		options.model = ch == 'c' ? BOTH : CGB;
-		if (options.titleLen > 15) {
-			options.titleLen = 15;
-			assume(options.title.has_value());
-			warning(
-			    WARNING_TRUNCATION, "Truncating title \"%s\" to 15 chars", options.title->c_str()
-			);
+		if (options.title) {
+			setTitleLen(options.titleLen);
 		}
 		break;
 
@@ -162,12 +184,8 @@ static void parseArg(int ch, char *arg) {
 			);
 		}
 		options.gameIDLen = len;
-		if (options.titleLen > 11) {
-			options.titleLen = 11;
-			assume(options.title.has_value());
-			warning(
-			    WARNING_TRUNCATION, "Truncating title \"%s\" to 11 chars", options.title->c_str()
-			);
+		if (options.title) {
+			setTitleLen(options.titleLen);
 		}
 		break;
 	}
@@ -231,23 +249,10 @@ static void parseArg(int ch, char *arg) {
 		options.sgb = true;
 		break;
 
-	case 't': {
+	case 't':
 		options.title = arg;
-		size_t len = options.title->length();
-		uint8_t maxLen = options.gameID ? 11 : options.model != DMG ? 15 : 16;
-
-		if (len > maxLen) {
-			len = maxLen;
-			warning(
-			    WARNING_TRUNCATION,
-			    "Truncating title \"%s\" to %u chars",
-			    options.title->c_str(),
-			    maxLen
-			);
-		}
-		options.titleLen = len;
+		setTitleLen(options.title->length());
 		break;
-	}
 
 		// LCOV_EXCL_START
 	case 'V':
@@ -268,8 +273,22 @@ static void parseArg(int ch, char *arg) {
 		break;
 
 	case 0: // Long-only options
-		if (longOpt == 'c' && !style_Parse(arg)) {
-			fatal("Invalid argument for option '--color'");
+		switch (longOpt) {
+		case 'c':
+			if (!style_Parse(arg)) {
+				fatal("Invalid argument for option '--color'");
+			}
+			break;
+
+		case 'j':
+			if (std::optional<uint64_t> value = parseWholeNumber(arg); !value) {
+				fatal("Invalid argument for option '--jobs'");
+			} else if (*value > UINT32_MAX) {
+				fatal("Argument for option '--jobs' is too large");
+			} else {
+				localOptions.nbJobs = *value;
+			}
+			break;
 		}
 		break;
 
@@ -284,12 +303,6 @@ static void parseArg(int ch, char *arg) {
 	}
 }
 
-static uint8_t const nintendoLogo[] = {
-    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
-    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
-    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
-};
-
 static void initLogo() {
 	if (options.logoFilename) {
 		FILE *logoFile;
@@ -344,6 +357,50 @@ static void initLogo() {
 	}
 }
 
+// Fixes independent files on several threads, then prints their diagnostics in order.
+// Returns whether fixing any of them failed.
+static bool fixConcurrently(std::vector<std::string> const &fileNames, size_t nbJobs) {
+	std::vector<FileDiagnostics> diags(fileNames.size());
+	for (FileDiagnostics &fileDiags : diags) {
+		fileDiags.deferred = true;
+	}
+	std::vector<bool> fileFailed(fileNames.size(), false);
+	std::vector<bool> fileDone(fileNames.size(), false);
+	std::mutex mutex;
+	std::condition_variable fileFinished;
+	std::atomic<size_t> nextFile = 0;
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < std::min(nbJobs, fileNames.size()); ++i) {
+		workers.emplace_back([&]() {
+			for (size_t file; (file = nextFile++) < fileNames.size();) {
+				bool failed = fix_ProcessFile(fileNames[file].c_str(), nullptr, diags[file]);
+
+				std::lock_guard lock(mutex);
+				fileFailed[file] = failed;
+				fileDone[file] = true;
+				fileFinished.notify_all();
+			}
+		});
+	}
+
+	// Print each file's diagnostics as soon as it and all of the files before it are done
+	bool failed = false;
+	for (size_t file = 0; file < fileNames.size(); ++file) {
+		{
+			std::unique_lock lock(mutex);
+			fileFinished.wait(lock, [&]() { return fileDone[file]; });
+			failed |= fileFailed[file];
+		}
+		diags[file].print();
+	}
+
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	return failed;
+}
+
 int main(int argc, char *argv[]) {
 	cli_ParseArgs(argc, argv, optstring, longopts, parseArg, usage);
 
@@ -408,8 +465,16 @@ int main(int argc, char *argv[]) {
 	char const *outputFileName =
 	    localOptions.outputFileName ? localOptions.outputFileName->c_str() : nullptr;
 	bool failed = warnings.nbErrors > 0;
-	for (std::string const &inputFileName : localOptions.inputFileNames) {
-		failed |= fix_ProcessFile(inputFileName.c_str(), outputFileName);
+	if (localOptions.nbJobs == 0) {
+		localOptions.nbJobs = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	if (localOptions.nbJobs > 1 && localOptions.inputFileNames.size() > 1) {
+		failed |= fixConcurrently(localOptions.inputFileNames, localOptions.nbJobs);
+	} else {
+		for (std::string const &inputFileName : localOptions.inputFileNames) {
+			FileDiagnostics diags;
+			failed |= fix_ProcessFile(inputFileName.c_str(), outputFileName, diags);
+		}
 	}
 
 	return failed;
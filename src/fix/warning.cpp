@@ -3,10 +3,12 @@
 #include "fix/warning.hpp"
 
 #include <inttypes.h>
+#include <optional>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string>
 
 #include "diagnostics.hpp"
 #include "style.hpp"
@@ -30,28 +32,86 @@ Diagnostics<WarningLevel, WarningID> warnings = {
 };
 // clang-format on
 
-uint32_t checkErrors(char const *filename) {
-	if (warnings.nbErrors > 0) {
-		style_Set(stderr, STYLE_RED, true);
-		fprintf(
-		    stderr,
-		    "Fixing \"%s\" failed with %" PRIu64 " error%s\n",
-		    filename,
-		    warnings.nbErrors,
-		    warnings.nbErrors == 1 ? "" : "s"
-		);
-		style_Reset(stderr);
+static thread_local FileDiagnostics *fileDiags = nullptr;
+
+void setFileDiagnostics(FileDiagnostics *diags) {
+	fileDiags = diags;
+}
+
+static void incrementErrors() {
+	if (!fileDiags) {
+		warnings.incrementErrors();
+	} else if (fileDiags->nbErrors != UINT64_MAX) {
+		++fileDiags->nbErrors;
+	}
+}
+
+[[gnu::format(printf, 2, 0)]]
+static void deferDiagnostic(std::optional<WarningID> id, char const *fmt, va_list args) {
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+	int len = vsnprintf(nullptr, 0, fmt, argsCopy);
+	va_end(argsCopy);
+
+	std::string message(len, '\0');
+	vsnprintf(message.data(), len + 1, fmt, args);
+	fileDiags->messages.emplace_back(id, std::move(message));
+}
+
+static void printErrorCount(char const *filename, uint64_t nbErrors) {
+	style_Set(stderr, STYLE_RED, true);
+	fprintf(
+	    stderr,
+	    "Fixing \"%s\" failed with %" PRIu64 " error%s\n",
+	    filename,
+	    nbErrors,
+	    nbErrors == 1 ? "" : "s"
+	);
+	style_Reset(stderr);
+}
+
+[[gnu::format(printf, 2, 3)]]
+static void printWarning(WarningID id, char const *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	printDiagnostic(warnings, id, fmt, args);
+	va_end(args);
+}
+
+void FileDiagnostics::print() const {
+	for (auto const &[id, message] : messages) {
+		if (id) {
+			printWarning(*id, "%s", message.c_str());
+		} else {
+			errorx("%s", message.c_str());
+		}
+	}
+	if (nbErrors > 0 && !name.empty()) {
+		printErrorCount(name.c_str(), nbErrors);
 	}
-	return warnings.nbErrors;
+}
+
+uint64_t checkErrors(char const *filename) {
+	uint64_t nbErrors = fileDiags ? fileDiags->nbErrors : warnings.nbErrors;
+	if (fileDiags && fileDiags->deferred) {
+		fileDiags->name = filename;
+	} else if (nbErrors > 0) {
+		printErrorCount(filename, nbErrors);
+	}
+	return nbErrors;
 }
 
 void error(char const *fmt, ...) {
 	va_list args;
 	va_start(args, fmt);
-	verrorx(fmt, args);
+	if (fileDiags && fileDiags->deferred) {
+		deferDiagnostic(std::nullopt, fmt, args);
+	} else {
+		verrorx(fmt, args);
+	}
 	va_end(args);
 
-	warnings.incrementErrors();
+	incrementErrors();
 }
 
 void fatal(char const *fmt, ...) {
@@ -64,12 +124,21 @@ void fatal(char const *fmt, ...) {
 }
 
 void warning(WarningID id, char const *fmt, ...) {
+	WarningBehavior behavior = warnings.getWarningBehavior(id);
+	if (behavior == WarningBehavior::DISABLED) {
+		return;
+	}
+
 	va_list args;
 	va_start(args, fmt);
-	WarningBehavior behavior = printDiagnostic(warnings, id, fmt, args);
+	if (fileDiags && fileDiags->deferred) {
+		deferDiagnostic(id, fmt, args);
+	} else {
+		printDiagnostic(warnings, id, fmt, args);
+	}
 	va_end(args);
 
 	if (behavior == WarningBehavior::ERROR) {
-		warnings.incrementErrors();
+		incrementErrors();
 	}
 }
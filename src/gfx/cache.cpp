@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: MIT
+
+#include "gfx/cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <errno.h>
+#include <filesystem>
+#include <inttypes.h>
+#include <ios>
+#include <optional>
+#include <random>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "file.hpp"
+#include "hash.hpp"
+#include "helpers.hpp" // RANGE
+#include "itertools.hpp"
+#include "version.hpp"
+
+#include "gfx/main.hpp"
+#include "gfx/png.hpp"
+#include "gfx/rgba.hpp"
+#include "gfx/warning.hpp"
+
+// Bumped whenever the layout of cache entries changes
+static std::array<uint8_t, 8> const entryMagic{'R', 'G', 'B', 'G', 'F', 'X', 'C', 2};
+
+static void appendSize(std::vector<uint8_t> &data, uint64_t size) {
+	for (size_t i = 0; i < 8; ++i) {
+		data.push_back(size >> (i * 8));
+	}
+}
+
+// Serializes the material of a cache key, with integers written byte by byte so that keys do not
+// depend on the host's endianness
+class KeyWriter {
+	std::vector<uint8_t> _material;
+
+public:
+	std::vector<uint8_t> takeMaterial() { return std::move(_material); }
+
+	template<typename T>
+	    requires std::is_integral_v<T>
+	void add(T value) {
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			_material.push_back(static_cast<uint64_t>(value) >> (i * 8));
+		}
+	}
+
+	void add(std::string const &str) {
+		appendSize(_material, str.size());
+		_material.insert(_material.end(), RANGE(str));
+	}
+
+	void add(std::vector<uint8_t> const &data) {
+		appendSize(_material, data.size());
+		_material.insert(_material.end(), RANGE(data));
+	}
+
+	void add(std::optional<Rgba> const &color) {
+		add(color.has_value());
+		if (color.has_value()) {
+			add(color->toCSS());
+		}
+	}
+};
+
+std::optional<CacheKey> computeCacheKey(Png const &png) {
+	KeyWriter writer;
+
+	// Different versions may generate different outputs from the same inputs
+	writer.add(std::string(get_package_version_string()));
+
+	writer.add(png.width);
+	writer.add(png.height);
+	for (Rgba const &pixel : png.pixels) {
+		writer.add(pixel.toCSS());
+	}
+	// The embedded palette is used for sorting, even without `-c embedded`
+	writer.add(png.palette.size());
+	for (Rgba const &color : png.palette) {
+		writer.add(color.toCSS());
+	}
+
+	writer.add(options.useColorCurve);
+	writer.add(options.allowDedup);
+	writer.add(options.allowMirroringX);
+	writer.add(options.allowMirroringY);
+	writer.add(options.columnMajor);
+	writer.add(options.bgColor);
+	writer.add(options.baseTileIDs[0]);
+	writer.add(options.baseTileIDs[1]);
+	writer.add(static_cast<uint8_t>(options.palSpecType));
+	writer.add(options.palSpec.size());
+	for (std::array<std::optional<Rgba>, 4> const &palette : options.palSpec) {
+		for (std::optional<Rgba> const &color : palette) {
+			writer.add(color);
+		}
+	}
+	writer.add(options.palSpecDmg);
+	writer.add(options.bitDepth);
+	writer.add(options.inputSlice.left);
+	writer.add(options.inputSlice.top);
+	writer.add(options.inputSlice.width);
+	writer.add(options.inputSlice.height);
+	writer.add(options.basePalID);
+	writer.add(options.maxNbTiles[0]);
+	writer.add(options.maxNbTiles[1]);
+	writer.add(options.nbPalettes);
+	writer.add(options.packTime);
+	writer.add(options.nbColorsPerPal);
+	writer.add(options.trim);
+
+	// Diagnostics are not stored, so these decide whether a conversion can be cached at all
+	DiagnosticsState<WarningID> const &state = warnings.state;
+	for (WarningID id : EnumSeq(NB_WARNINGS)) {
+		for (WarningState const &warning : {state.flagStates[id], state.metaStates[id]}) {
+			writer.add(static_cast<uint8_t>(warning.state));
+			writer.add(static_cast<uint8_t>(warning.error));
+		}
+	}
+	writer.add(state.warningsEnabled);
+	writer.add(state.warningsAreErrors);
+
+	// Only the outputs that were requested are stored, so they are part of the key as well
+	writer.add(!options.output.empty());
+	writer.add(!options.tilemap.empty());
+	writer.add(!options.attrmap.empty());
+	writer.add(!options.palmap.empty());
+	writer.add(!options.palettes.empty());
+
+	if (!options.inputTileset.empty()) {
+		// Reading the tileset from stdin here would prevent the conversion itself from reading it
+		if (options.inputTileset == "-") {
+			return std::nullopt;
+		}
+		File file;
+		if (!file.open(options.inputTileset, std::ios_base::in | std::ios_base::binary)) {
+			return std::nullopt; // Let the conversion report the error
+		}
+		writer.add(file.readAll());
+	}
+
+	CacheKey key{.material = writer.takeMaterial(), .hash = 0};
+	Hasher keyHasher;
+	keyHasher.addBytes(key.material.data(), key.material.size());
+	key.hash = keyHasher.value();
+	return key;
+}
+
+static std::string entryPath(uint64_t key) {
+	char name[sizeof("0123456789abcdef")];
+	snprintf(name, sizeof(name), "%016" PRIx64, key);
+	return (std::filesystem::path(options.cacheDir) / name).string();
+}
+
+// Reads a size followed by that many bytes, returning where they start
+static std::optional<size_t>
+    readSized(std::vector<uint8_t> const &entry, size_t &ofs, uint64_t &size) {
+	if (entry.size() - ofs < 8) {
+		return std::nullopt;
+	}
+	size = 0;
+	for (size_t i = 0; i < 8; ++i) {
+		size |= static_cast<uint64_t>(entry[ofs++]) << (i * 8);
+	}
+	if (entry.size() - ofs < size) {
+		return std::nullopt;
+	}
+	size_t start = ofs;
+	ofs += size;
+	return start;
+}
+
+std::optional<CachedOutputs> loadFromCache(CacheKey const &key) {
+	File file;
+	if (!file.open(entryPath(key.hash), std::ios_base::in | std::ios_base::binary)) {
+		return std::nullopt; // Not cached yet
+	}
+	std::vector<uint8_t> entry = file.readAll();
+
+	// Malformed entries are treated as missing, and will be overwritten
+	if (entry.size() < entryMagic.size() || !std::equal(RANGE(entryMagic), entry.begin())) {
+		return std::nullopt;
+	}
+	size_t ofs = entryMagic.size();
+	uint64_t size = 0;
+
+	// An entry for other inputs whose hash collides with these is treated as missing too
+	std::optional<size_t> material = readSized(entry, ofs, size);
+	if (!material || size != key.material.size()
+	    || !std::equal(RANGE(key.material), entry.begin() + *material)) {
+		return std::nullopt;
+	}
+
+	CachedOutputs outputs;
+	for (std::optional<std::vector<uint8_t>> &output : outputs) {
+		if (ofs == entry.size()) {
+			return std::nullopt;
+		}
+		if (!entry[ofs++]) {
+			continue; // This output was not requested
+		}
+
+		std::optional<size_t> start = readSized(entry, ofs, size);
+		if (!start) {
+			return std::nullopt;
+		}
+		output.emplace(entry.begin() + *start, entry.begin() + *start + size);
+	}
+	if (ofs != entry.size()) {
+		return std::nullopt;
+	}
+	return outputs;
+}
+
+void storeInCache(CacheKey const &key, CachedOutputs const &outputs) {
+	std::error_code error;
+	std::filesystem::create_directories(options.cacheDir, error);
+	if (error) {
+		warnx(
+		    "Failed to create cache directory \"%s\": %s",
+		    options.cacheDir.c_str(),
+		    error.message().c_str()
+		);
+		return;
+	}
+
+	std::vector<uint8_t> entry(RANGE(entryMagic));
+	appendSize(entry, key.material.size());
+	entry.insert(entry.end(), RANGE(key.material));
+	for (std::optional<std::vector<uint8_t>> const &output : outputs) {
+		entry.push_back(output.has_value());
+		if (!output.has_value()) {
+			continue;
+		}
+		appendSize(entry, output->size());
+		entry.insert(entry.end(), RANGE(*output));
+	}
+
+	// Write to a temporary file first, so that concurrent runs never read a partial entry
+	std::string path = entryPath(key.hash);
+	std::string tmpPath = path + ".tmp" + std::to_string(std::random_device{}());
+	bool written;
+	{
+		File file;
+		written = file.open(tmpPath, std::ios_base::out | std::ios_base::binary)
+		          && file.writeAll(entry) && file->pubsync() == 0;
+	}
+	if (!written) {
+		warnx("Failed to write cache entry \"%s\": %s", tmpPath.c_str(), strerror(errno));
+	} else if (std::filesystem::rename(tmpPath, path, error); error) {
+		warnx("Failed to write cache entry \"%s\": %s", path.c_str(), error.message().c_str());
+	} else {
+		return;
+	}
+	std::filesystem::remove(tmpPath, error);
+}
@@ -3,6 +3,7 @@
 #include "gfx/color_set.hpp"
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <stdint.h>
 #include <stdlib.h>
@@ -41,45 +42,17 @@ void ColorSet::add(uint16_t color) {
 	_colorIndices[i] = color;
 }
 
-ColorSet::ComparisonResult ColorSet::compare(ColorSet const &other) const {
-	// This algorithm works because the sets are sorted numerically
-	assume(std::is_sorted(RANGE(_colorIndices)));
-	assume(std::is_sorted(RANGE(other._colorIndices)));
-
-	auto self_item = begin(), other_item = other.begin();
-	auto const self_end = end(), other_end = other.end();
-	bool self_has_unique = false, other_has_unique = false;
-
-	while (self_item != self_end && other_item != other_end) {
-		if (*self_item < *other_item) {
-			// *self_item is not in other, so self cannot be a strict subset of other
-			self_has_unique = true;
-			++self_item;
-		} else if (*self_item > *other_item) {
-			// *other_item is not in self, so self cannot be a strict superset of other
-			other_has_unique = true;
-			++other_item;
-		} else {
-			// *self_item == *other_item, so continue comparing
-			++self_item;
-			++other_item;
-		}
+ColorSet ColorSet::subset(unsigned mask) const {
+	ColorSet colorSet;
+	size_t i = 0;
 
-		// Early return optimization: we already know self and other are incomparable
-		if (self_has_unique && other_has_unique) {
-			return INCOMPARABLE;
+	// Since the colors are picked in order, the result is sorted as well
+	for (size_t n = 0; n < capacity && _colorIndices[n] != UINT16_MAX; ++n) {
+		if (mask & 1u << n) {
+			colorSet._colorIndices[i++] = _colorIndices[n];
 		}
 	}
-
-	// Check if either color set has unique items remaining after one set has been fully iterated
-	if (self_item != self_end) {
-		self_has_unique = true;
-	}
-	if (other_item != other_end) {
-		other_has_unique = true;
-	}
-
-	return self_has_unique ? other_has_unique ? INCOMPARABLE : STRICT_SUPERSET : SUBSET_OR_EQUAL;
+	return colorSet;
 }
 
 size_t ColorSet::size() const {
@@ -90,6 +63,15 @@ bool ColorSet::empty() const {
 	return _colorIndices[0] == UINT16_MAX;
 }
 
+size_t ColorSet::hash() const {
+	// The four 16-bit slots fit exactly in 64 bits, and are unique to each set
+	uint64_t packed = 0;
+	for (uint16_t color : _colorIndices) {
+		packed = packed << 16 | color;
+	}
+	return std::hash<uint64_t>{}(packed);
+}
+
 auto ColorSet::begin() const -> decltype(_colorIndices)::const_iterator {
 	return _colorIndices.begin();
 }
@@ -51,7 +51,7 @@ static struct LocalOptions {
 static char const *optstring = "Aa:B:b:Cc:d:hi:L:l:mN:n:Oo:Pp:Qq:r:s:Tt:U:uVvW:wXx:YZ";
 
 // Long-only option variable
-static int longOpt; // `--color`
+static int longOpt; // `--cache`, `--color`, `--compression`, `--pack-time`
 
 // Equivalent long options
 // Please keep in the same order as short opts.
@@ -94,7 +94,10 @@ static option const longopts[] = {
     {"trim-end",         required_argument, nullptr,  'x'},
     {"mirror-y",         no_argument,       nullptr,  'Y'},
     {"columns",          no_argument,       nullptr,  'Z'},
+    {"cache",            required_argument, &longOpt, 'C'},
     {"color",            required_argument, &longOpt, 'c'},
+    {"compression",      required_argument, &longOpt, 'z'},
+    {"pack-time",        required_argument, &longOpt, 'p'},
     {nullptr,            no_argument,       nullptr,  0  },
 };
 
@@ -446,8 +449,39 @@ static void parseArg(int ch, char *arg) {
 		break;
 
 	case 0: // Long-only options
-		if (longOpt == 'c' && !style_Parse(arg)) {
-			fatal("Invalid argument for option '--color'");
+		switch (longOpt) {
+		case 'C':
+			options.cacheDir = arg;
+			break;
+
+		case 'c':
+			if (!style_Parse(arg)) {
+				fatal("Invalid argument for option '--color'");
+			}
+			break;
+
+		case 'p':
+			options.packTime = readNumber(argPtr, "Palette packing time", 0);
+			if (*argPtr != '\0') {
+				error(
+				    "Palette packing time ('--pack-time') must be a valid number, not \"%s\"", arg
+				);
+			}
+			break;
+
+		case 'z': {
+			uint16_t number = readNumber(argPtr, "Compression level", 0);
+			if (*argPtr != '\0') {
+				error(
+				    "Compression level ('--compression') must be a valid number, not \"%s\"", arg
+				);
+			} else if (number > 9) {
+				error("Compression level must be between 0 and 9, not %" PRIu16, number);
+			} else {
+				options.compressionLevel = number;
+			}
+			break;
+		}
 		}
 		break;
 
@@ -513,6 +547,18 @@ static void verboseOutputConfig() {
 	fprintf(stderr, "\tMaximum %" PRIu16 " palettes\n", options.nbPalettes);
 	// -s/--palette-size
 	fprintf(stderr, "\tPalettes contain %" PRIu8 " colors\n", options.nbColorsPerPal);
+	// --cache
+	if (!options.cacheDir.empty()) {
+		fprintf(stderr, "\tCache directory: \"%s\"\n", options.cacheDir.c_str());
+	}
+	// --compression
+	if (options.compressionLevel.has_value()) {
+		fprintf(stderr, "\tPNG compression level: %" PRIu8 "\n", *options.compressionLevel);
+	}
+	// --pack-time
+	if (options.packTime != 0) {
+		fprintf(stderr, "\tSearch palette packings for up to %" PRIu16 " ms\n", options.packTime);
+	}
 	// -c/--colors
 	if (options.palSpecType == Options::NO_SPEC) {
 		fputs("\tAutomatic palette generation\n", stderr);
@@ -3,15 +3,20 @@
 #include "gfx/pal_packing.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <inttypes.h>
 #include <iterator>
+#include <mutex>
 #include <numeric>
 #include <optional>
 #include <queue>
+#include <random>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <thread>
 #include <type_traits>
 #include <unordered_set>
 #include <utility>
@@ -34,6 +39,17 @@
 // Tile   | Color set
 // Page   | Palette
 
+// The packing search (`--pack-time`) runs the same solvers on several threads at once;
+// only the main, deterministic run's steps are worth reporting.
+static thread_local bool isSearching = false;
+
+#define packingPrint(level, ...) \
+	do { \
+		if (!isSearching) { \
+			verbosePrint(level, __VA_ARGS__); \
+		} \
+	} while (0)
+
 // A reference to a color set, and attached attributes for sorting purposes
 struct ColorSetAttrs {
 	size_t colorSetIndex;
@@ -262,6 +278,9 @@ public:
 static void verboseOutputAssignments(
     std::vector<AssignedSets> const &assignments, std::vector<ColorSet> const &colorSets
 ) {
+	if (isSearching) {
+		return;
+	}
 	verboseDo(VERB_INFO, [&]() {
 		for (AssignedSets const &assignment : assignments) {
 			fputs("- { ", stderr);
@@ -304,7 +323,7 @@ static void decant(std::vector<AssignedSets> &assignments, std::vector<ColorSet>
 		}
 	};
 
-	verbosePrint(VERB_DEBUG, "%zu palettes before decanting\n", assignments.size());
+	packingPrint(VERB_DEBUG, "%zu palettes before decanting\n", assignments.size());
 
 	// Decant on palettes
 	decantOn([&colorSets](AssignedSets &to, AssignedSets &from) {
@@ -316,7 +335,7 @@ static void decant(std::vector<AssignedSets> &assignments, std::vector<ColorSet>
 			from.clear();
 		}
 	});
-	verbosePrint(VERB_DEBUG, "%zu palettes after decanting on palettes\n", assignments.size());
+	packingPrint(VERB_DEBUG, "%zu palettes after decanting on palettes\n", assignments.size());
 
 	// Decant on "components" (color sets sharing colors)
 	decantOn([&colorSets](AssignedSets &to, AssignedSets &from) {
@@ -361,7 +380,7 @@ static void decant(std::vector<AssignedSets> &assignments, std::vector<ColorSet>
 			}
 		}
 	});
-	verbosePrint(
+	packingPrint(
 	    VERB_DEBUG, "%zu palettes after decanting on \"components\"\n", assignments.size()
 	);
 
@@ -374,26 +393,13 @@ static void decant(std::vector<AssignedSets> &assignments, std::vector<ColorSet>
 			}
 		}
 	});
-	verbosePrint(VERB_DEBUG, "%zu palettes after decanting on color sets\n", assignments.size());
+	packingPrint(VERB_DEBUG, "%zu palettes after decanting on color sets\n", assignments.size());
 }
 
-std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> const &colorSets) {
-	verbosePrint(VERB_NOTICE, "Paginating palettes using \"overload-and-remove\" strategy...\n");
-
-	// Sort the color sets by size, which improves the packing algorithm's efficiency
-	auto const indexOfLargestColorSetFirst = [&colorSets](size_t left, size_t right) {
-		ColorSet const &lhs = colorSets[left];
-		ColorSet const &rhs = colorSets[right];
-		return lhs.size() > rhs.size(); // We want the color sets to be sorted *largest first*!
-	};
-	std::vector<size_t> sortedColorSetIDs;
-	sortedColorSetIDs.reserve(colorSets.size());
-	for (size_t i = 0; i < colorSets.size(); ++i) {
-		sortedColorSetIDs.insert(
-		    std::lower_bound(RANGE(sortedColorSetIDs), i, indexOfLargestColorSetFirst), i
-		);
-	}
-
+// Runs the "overload-and-remove" solver, inserting the color sets in the given order
+static std::vector<AssignedSets> paginate(
+    std::vector<ColorSet> const &colorSets, std::vector<size_t> const &sortedColorSetIDs
+) {
 	// Begin with no pages
 	std::vector<AssignedSets> assignments;
 
@@ -402,7 +408,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 	     !queue.empty();
 	     queue.pop()) {
 		ColorSetAttrs const &attrs = queue.front(); // Valid until the `queue.pop()`
-		verbosePrint(VERB_TRACE, "Handling color set %zu\n", attrs.colorSetIndex);
+		packingPrint(VERB_TRACE, "Handling color set %zu\n", attrs.colorSetIndex);
 
 		ColorSet const &colorSet = colorSets[attrs.colorSetIndex];
 		size_t bestPalIndex = assignments.size();
@@ -417,7 +423,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 			}
 
 			uint32_t relSize = assignments[i].relSizeOf(colorSet);
-			verbosePrint(
+			packingPrint(
 			    VERB_TRACE,
 			    "  Relative size to palette %zu (of %zu): %" PRIu32 " (size = %zu)\n",
 			    i,
@@ -433,7 +439,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 
 		if (bestPalIndex == assignments.size()) {
 			// Found nowhere to put it, create a new page containing just that one
-			verbosePrint(
+			packingPrint(
 			    VERB_TRACE,
 			    "Assigning color set %zu to new palette %zu\n",
 			    attrs.colorSetIndex,
@@ -443,7 +449,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 			continue;
 		}
 
-		verbosePrint(
+		packingPrint(
 		    VERB_TRACE,
 		    "Assigning color set %zu to palette %zu\n",
 		    attrs.colorSetIndex,
@@ -461,7 +467,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 			uint32_t relSize1 = bestPal.relSizeOf(colorSet1);
 			uint32_t relSize2 = bestPal.relSizeOf(colorSet2);
 
-			verbosePrint(
+			packingPrint(
 			    VERB_TRACE,
 			    "  Color sets %zu <=> %zu: Efficiency: %zu / %" PRIu32 " <=> %zu / "
 			    "%" PRIu32 "\n",
@@ -483,7 +489,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 
 		// If this overloads the palette, get it back to normal (if possible)
 		while (bestPal.volume() > options.maxOpaqueColors()) {
-			verbosePrint(
+			packingPrint(
 			    VERB_TRACE,
 			    "Palette %zu is overloaded! (%zu > %" PRIu8 ")\n",
 			    bestPalIndex,
@@ -501,12 +507,12 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 
 			// All efficiencies are identical iff min equals max
 			if (compareEfficiency(*minEfficiencyIter, *maxEfficiencyIter) == 0) {
-				verbosePrint(VERB_TRACE, "  All efficiencies are identical\n");
+				packingPrint(VERB_TRACE, "  All efficiencies are identical\n");
 				break;
 			}
 
 			// Remove the color set with minimal efficiency
-			verbosePrint(
+			packingPrint(
 			    VERB_TRACE, "  Removing color set %zu\n", minEfficiencyIter->colorSetIndex
 			);
 			queue.emplace(std::move(*minEfficiencyIter));
@@ -539,7 +545,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 			return pal.canFit(colorSet);
 		});
 		if (palette == assignments.end()) { // No such page, create a new one
-			verbosePrint(
+			packingPrint(
 			    VERB_DEBUG,
 			    "Adding new palette (%zu) for overflowing color set %zu\n",
 			    assignments.size(),
@@ -547,7 +553,7 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 			);
 			assignments.emplace_back(colorSets, std::move(attrs));
 		} else {
-			verbosePrint(
+			packingPrint(
 			    VERB_DEBUG,
 			    "Assigning overflowing color set %zu to palette %zu\n",
 			    attrs.colorSetIndex,
@@ -565,11 +571,293 @@ std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> c
 
 	verboseOutputAssignments(assignments, colorSets);
 
+	return assignments;
+}
+
+static std::vector<size_t> getMappings(
+    std::vector<AssignedSets> const &assignments, std::vector<ColorSet> const &colorSets
+) {
 	std::vector<size_t> mappings(colorSets.size());
 	for (size_t i = 0; i < assignments.size(); ++i) {
 		for (ColorSetAttrs const &attrs : assignments[i]) {
 			mappings[attrs.colorSetIndex] = i;
 		}
 	}
-	return {mappings, assignments.size()};
+	return mappings;
+}
+
+// Sorts the color set IDs by size, largest first, keeping same-size ones in their current order
+static void
+    sortLargestFirst(std::vector<ColorSet> const &colorSets, std::vector<size_t> &colorSetIDs) {
+	std::stable_sort(RANGE(colorSetIDs), [&colorSets](size_t left, size_t right) {
+		return colorSets[left].size() > colorSets[right].size();
+	});
+}
+
+// Exhaustively searches for a packing using at most a given number of palettes, by trying to
+// put each color set (largest first) into every palette it fits in, backtracking on failure.
+class ExactPacker {
+	std::vector<ColorSet> const &_colorSets;
+	std::vector<size_t> _order;
+	std::vector<ColorSet> _palettes; // The union of the color sets assigned to each palette
+	std::vector<size_t> _mappings;
+	size_t _maxNbPalettes = 0;
+	// Polled periodically, so that we can give up
+	std::chrono::steady_clock::time_point _deadline;
+	std::atomic<bool> const &_done;
+	size_t _nbSteps = 0;
+	bool _stopped = false;
+
+	// Returns how many colors a palette would contain if the color set was added to it
+	static size_t mergedSize(ColorSet const &palette, ColorSet const &colorSet) {
+		return palette.size() + std::count_if(RANGE(colorSet), [&palette](uint16_t color) {
+			       return std::find(RANGE(palette), color) == palette.end();
+		       });
+	}
+
+	// How a color set was placed, so that it can be undone
+	struct Placement {
+		size_t palette;
+		ColorSet previous; // The palette's colors before the color set was added to it
+		bool isNewPalette;
+		bool isOnlyChoice; // The color set fit for free, so no other palette needs to be tried
+	};
+
+	// Adds the color set to the first palette it fits in, trying them from `firstCandidate` on;
+	// opening a new palette is the last candidate.
+	std::optional<Placement> placeNext(ColorSet const &colorSet, size_t firstCandidate) {
+		if (firstCandidate == 0) {
+			// If a palette already contains all of the color set's colors, using it costs
+			// nothing, so no other choice can be better
+			for (size_t p = 0; p < _palettes.size(); ++p) {
+				if (mergedSize(_palettes[p], colorSet) == _palettes[p].size()) {
+					return Placement{
+					    .palette = p,
+					    .previous = _palettes[p],
+					    .isNewPalette = false,
+					    .isOnlyChoice = true,
+					};
+				}
+			}
+		}
+
+		for (size_t p = firstCandidate; p < _palettes.size(); ++p) {
+			if (mergedSize(_palettes[p], colorSet) > options.maxOpaqueColors()) {
+				continue;
+			}
+			Placement placement{
+			    .palette = p,
+			    .previous = _palettes[p],
+			    .isNewPalette = false,
+			    .isOnlyChoice = false,
+			};
+			for (uint16_t color : colorSet) {
+				_palettes[p].add(color);
+			}
+			return placement;
+		}
+
+		// Opening a new palette is the same no matter which one it is, so only try one
+		if (firstCandidate <= _palettes.size() && _palettes.size() < _maxNbPalettes) {
+			_palettes.push_back(colorSet);
+			return Placement{
+			    .palette = _palettes.size() - 1,
+			    .previous = {},
+			    .isNewPalette = true,
+			    .isOnlyChoice = false,
+			};
+		}
+		return std::nullopt;
+	}
+
+	// Backtracks with an explicit stack rather than by recursing, since there may be as many
+	// color sets as tiles, and the search runs on threads with small stacks
+	bool placeAll() {
+		std::vector<Placement> placements;
+		size_t firstCandidate = 0; // The first palette to try for the next color set
+		while (placements.size() < _order.size()) {
+			if (++_nbSteps % 1024 == 0
+			    && (_done || std::chrono::steady_clock::now() >= _deadline)) {
+				_stopped = true;
+			}
+			if (_stopped) {
+				return false;
+			}
+
+			size_t colorSetID = _order[placements.size()];
+			if (std::optional<Placement> placement =
+			        placeNext(_colorSets[colorSetID], firstCandidate);
+			    placement) {
+				_mappings[colorSetID] = placement->palette;
+				placements.push_back(*placement);
+				firstCandidate = 0;
+				continue;
+			}
+
+			// This color set fits nowhere, so move the previous one to its next candidate
+			if (placements.empty()) {
+				return false;
+			}
+			Placement const &last = placements.back();
+			if (last.isNewPalette) {
+				_palettes.pop_back();
+			} else {
+				_palettes[last.palette] = last.previous;
+			}
+			firstCandidate = last.isOnlyChoice ? SIZE_MAX : last.palette + 1;
+			placements.pop_back();
+		}
+		return true;
+	}
+
+public:
+	ExactPacker(
+	    std::vector<ColorSet> const &colorSets,
+	    std::chrono::steady_clock::time_point deadline,
+	    std::atomic<bool> const &done
+	)
+	    : _colorSets(colorSets),
+	      _order(colorSets.size()),
+	      _mappings(colorSets.size()),
+	      _deadline(deadline),
+	      _done(done) {
+		std::iota(RANGE(_order), 0);
+		sortLargestFirst(colorSets, _order);
+	}
+
+	// Returns the mappings of a packing using at most `maxNbPalettes` palettes, if any was
+	// found; `stopped()` tells whether the search was exhaustive.
+	std::optional<std::pair<std::vector<size_t>, size_t>> pack(size_t maxNbPalettes) {
+		_maxNbPalettes = maxNbPalettes;
+		_palettes.clear();
+		if (!placeAll()) {
+			return std::nullopt;
+		}
+		return std::pair{_mappings, _palettes.size()};
+	}
+
+	bool stopped() const { return _stopped; }
+};
+
+// Tries to find a packing using fewer palettes than the given one, running several strategies
+// on all threads until `options.packTime` milliseconds have elapsed.
+static void searchPacking(
+    std::vector<ColorSet> const &colorSets, std::vector<size_t> &mappings, size_t &nbPalettes
+) {
+	auto const deadline =
+	    std::chrono::steady_clock::now() + std::chrono::milliseconds(options.packTime);
+
+	// Every color needs a slot in at least one palette, so no packing can do better than this
+	std::unordered_set<uint16_t> colors;
+	for (ColorSet const &colorSet : colorSets) {
+		colors.insert(RANGE(colorSet));
+	}
+	size_t lowerBound = std::max<size_t>(
+	    (colors.size() + options.maxOpaqueColors() - 1) / options.maxOpaqueColors(), 1
+	);
+	// There is no need to keep searching once the palettes fit
+	size_t target = std::max<size_t>(lowerBound, options.nbPalettes);
+
+	std::mutex mutex; // Protects `mappings` and `nbPalettes`
+	std::atomic<size_t> bestNbPalettes = nbPalettes;
+	std::atomic<bool> done = bestNbPalettes <= target;
+	auto shouldStop = [&]() {
+		return done || std::chrono::steady_clock::now() >= deadline;
+	};
+	auto record = [&](std::vector<size_t> const &newMappings, size_t newNbPalettes) {
+		std::lock_guard lock(mutex);
+		if (newNbPalettes < nbPalettes) {
+			mappings = newMappings;
+			nbPalettes = newNbPalettes;
+			bestNbPalettes = newNbPalettes;
+			if (newNbPalettes <= target) {
+				done = true;
+			}
+		}
+	};
+
+	// One thread searches exhaustively, which is feasible for small images...
+	auto searchExhaustively = [&]() {
+		isSearching = true;
+		ExactPacker packer(colorSets, deadline, done);
+		while (bestNbPalettes > target) {
+			std::optional<std::pair<std::vector<size_t>, size_t>> packing =
+			    packer.pack(bestNbPalettes - 1);
+			if (packing) {
+				record(packing->first, packing->second);
+			} else {
+				if (!packer.stopped()) {
+					done = true; // There is no better packing than what we already have
+				}
+				break;
+			}
+		}
+	};
+	// ...and the others restart the heuristic with different insertion orders
+	auto searchRandomly = [&](size_t firstAttempt, size_t nbWorkers) {
+		isSearching = true;
+		std::vector<size_t> order(colorSets.size());
+		for (size_t attempt = firstAttempt; !shouldStop(); attempt += nbWorkers) {
+			std::mt19937 rng(attempt); // Seeded deterministically, to ease reproducing results
+			std::iota(RANGE(order), 0);
+			std::shuffle(RANGE(order), rng);
+			if (attempt % 2 == 0) {
+				// Keep the largest-first order, which tends to give better results,
+				// but break ties differently from the default run
+				sortLargestFirst(colorSets, order);
+			}
+			std::vector<AssignedSets> assignments = paginate(colorSets, order);
+			if (assignments.size() < bestNbPalettes) {
+				record(getMappings(assignments, colorSets), assignments.size());
+			}
+		}
+	};
+
+	size_t nbWorkers = std::max(std::thread::hardware_concurrency(), 2u);
+	verbosePrint(
+	    VERB_NOTICE,
+	    "Searching for a packing with fewer than %zu palettes (%zu threads, %" PRIu16 " ms)...\n",
+	    nbPalettes,
+	    nbWorkers,
+	    options.packTime
+	);
+
+	std::vector<std::thread> workers;
+	workers.emplace_back(searchExhaustively);
+	for (size_t i = 1; i < nbWorkers; ++i) {
+		workers.emplace_back(searchRandomly, i - 1, nbWorkers - 1);
+	}
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	verbosePrint(VERB_INFO, "Packing search settled on %zu palettes\n", nbPalettes);
+}
+
+std::pair<std::vector<size_t>, size_t> overloadAndRemove(std::vector<ColorSet> const &colorSets) {
+	verbosePrint(VERB_NOTICE, "Paginating palettes using \"overload-and-remove\" strategy...\n");
+
+	// Sort the color sets by size, which improves the packing algorithm's efficiency
+	auto const indexOfLargestColorSetFirst = [&colorSets](size_t left, size_t right) {
+		ColorSet const &lhs = colorSets[left];
+		ColorSet const &rhs = colorSets[right];
+		return lhs.size() > rhs.size(); // We want the color sets to be sorted *largest first*!
+	};
+	std::vector<size_t> sortedColorSetIDs;
+	sortedColorSetIDs.reserve(colorSets.size());
+	for (size_t i = 0; i < colorSets.size(); ++i) {
+		sortedColorSetIDs.insert(
+		    std::lower_bound(RANGE(sortedColorSetIDs), i, indexOfLargestColorSetFirst), i
+		);
+	}
+
+	std::vector<AssignedSets> assignments = paginate(colorSets, sortedColorSetIDs);
+
+	std::vector<size_t> mappings = getMappings(assignments, colorSets);
+	size_t nbPalettes = assignments.size();
+	// The heuristic is not optimal, so look harder if it didn't manage to fit (when allowed to)
+	if (options.packTime != 0 && nbPalettes > options.nbPalettes) {
+		searchPacking(colorSets, mappings, nbPalettes);
+	}
+	return {mappings, nbPalettes};
 }
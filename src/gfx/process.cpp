@@ -14,6 +14,7 @@
 #include <string.h>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -24,6 +25,7 @@
 #include "itertools.hpp"
 #include "verbosity.hpp"
 
+#include "gfx/cache.hpp"
 #include "gfx/color_set.hpp"
 #include "gfx/flip.hpp"
 #include "gfx/main.hpp"
@@ -320,6 +322,123 @@ struct AttrmapEntry {
 	}
 };
 
+// Collects the color sets of an image's tiles, such that none of them is a subset of another.
+// Sets live in "slots" which are never renumbered while tiles are being visited: when a new set
+// is a strict superset of existing ones, it takes over the lowest slot and the other slots are
+// merged into it (union-find), so that attrmap entries only need fixing up once, at the end.
+class ColorSetCollection {
+	std::vector<ColorSet> _sets;  // Indexed by slot; dead slots keep their last set
+	std::vector<size_t> _parents; // A slot is live iff it is its own parent
+	// Maps each live set to its slot
+	std::unordered_map<ColorSet, size_t> _slots;
+	// Maps every subset of every set ever stored to the lowest slot that stored a superset of it.
+	// A slot's set only ever grows, and a slot only dies by being merged into a lower slot whose
+	// set is a superset of its own; thus, these lowest slots are always live supersets.
+	std::unordered_map<ColorSet, size_t> _lowestSuperset;
+	size_t _nbLive = 0;
+
+	void registerSubsets(ColorSet const &colorSet, size_t slot) {
+		for (unsigned mask = 1; mask < 1u << colorSet.size(); ++mask) {
+			auto [iter, inserted] = _lowestSuperset.try_emplace(colorSet.subset(mask), slot);
+			if (!inserted && iter->second > slot) {
+				iter->second = slot;
+			}
+		}
+	}
+
+	size_t findRoot(size_t slot) {
+		while (_parents[slot] != slot) {
+			_parents[slot] = _parents[_parents[slot]]; // Path halving
+			slot = _parents[slot];
+		}
+		return slot;
+	}
+
+public:
+	size_t size() const { return _nbLive; }
+	size_t nbSlots() const { return _sets.size(); }
+	ColorSet const &operator[](size_t slot) const { return _sets[slot]; }
+
+	// Returns the ID that a live slot would get if the collection were compacted now.
+	size_t idOf(size_t slot) const {
+		size_t id = 0;
+		for (size_t i = 0; i < slot; ++i) {
+			if (_parents[i] == i) {
+				++id;
+			}
+		}
+		return id;
+	}
+
+	// Returns the lowest slot whose set is a superset of (or equal to) the given one, if any.
+	std::optional<size_t> findSuperset(ColorSet const &colorSet) const {
+		if (auto search = _lowestSuperset.find(colorSet); search != _lowestSuperset.end()) {
+			return search->second;
+		}
+		return std::nullopt;
+	}
+
+	// Returns the slots whose sets are strict subsets of the given one, in increasing order.
+	std::vector<size_t> findStrictSubsets(ColorSet const &colorSet) const {
+		std::vector<size_t> subsets;
+		unsigned full = (1u << colorSet.size()) - 1;
+		for (unsigned mask = 1; mask < full; ++mask) {
+			if (auto search = _slots.find(colorSet.subset(mask)); search != _slots.end()) {
+				subsets.push_back(search->second);
+			}
+		}
+		std::sort(RANGE(subsets));
+		return subsets;
+	}
+
+	size_t add(ColorSet const &colorSet) {
+		size_t slot = _sets.size();
+		_sets.push_back(colorSet);
+		_parents.push_back(slot);
+		_slots.emplace(colorSet, slot);
+		registerSubsets(colorSet, slot);
+		++_nbLive;
+		return slot;
+	}
+
+	// Replaces the set in `slot` with a strict superset of it.
+	void replace(size_t slot, ColorSet const &colorSet) {
+		_slots.erase(_sets[slot]);
+		_sets[slot] = colorSet;
+		_slots.emplace(colorSet, slot);
+		registerSubsets(colorSet, slot);
+	}
+
+	// Merges `slot` into the lower `into`, whose set must be a strict superset of its own.
+	void merge(size_t slot, size_t into) {
+		assume(into < slot);
+		_slots.erase(_sets[slot]);
+		_parents[slot] = into;
+		--_nbLive;
+	}
+
+	// Returns the live sets in slot order, and renumbers the attrmap entries accordingly.
+	std::vector<ColorSet> compact(std::vector<AttrmapEntry> &attrmap) {
+		std::vector<ColorSet> colorSets;
+		std::vector<size_t> ids(_sets.size());
+		colorSets.reserve(_nbLive);
+		for (size_t slot = 0; slot < _sets.size(); ++slot) {
+			if (_parents[slot] == slot) {
+				ids[slot] = colorSets.size();
+				colorSets.push_back(_sets[slot]);
+			}
+		}
+
+		for (AttrmapEntry &entry : attrmap) {
+			if (entry.colorSetID != AttrmapEntry::transparent
+			    && entry.colorSetID != AttrmapEntry::background) {
+				entry.colorSetID = ids[findRoot(entry.colorSetID)];
+			}
+		}
+		return colorSets;
+	}
+};
+
 static void generatePalSpec(Image const &image) {
 	// Generate a palette spec from the first few colors in the embedded palette
 	std::vector<Rgba> const &embPal = image.png.palette;
@@ -449,6 +568,48 @@ static std::pair<std::vector<size_t>, std::vector<Palette>>
 	return {mappings, palettes};
 }
 
+// The outputs to store in the cache once the conversion succeeds, if caching is enabled
+static std::optional<CachedOutputs> outputsToCache;
+// Cache hits do not print diagnostics again, so conversions that print any are not cached
+static uint64_t nbDiagnosticsBeforeConversion;
+
+static std::string const &outputPath(CachedOutput which) {
+	switch (which) {
+	case OUTPUT_TILES:
+		return options.output;
+	case OUTPUT_TILEMAP:
+		return options.tilemap;
+	case OUTPUT_ATTRMAP:
+		return options.attrmap;
+	case OUTPUT_PALMAP:
+		return options.palmap;
+	case OUTPUT_PALETTES:
+	case NB_CACHED_OUTPUTS:
+		break;
+	}
+	return options.palettes;
+}
+
+// Outputs are serialized in memory first, then written to their file all at once
+static void writeOutput(CachedOutput which, std::vector<uint8_t> const &data) {
+	if (outputsToCache) {
+		(*outputsToCache)[which] = data;
+	}
+
+	std::string const &path = outputPath(which);
+	File output;
+	if (!output.open(path, std::ios_base::out | std::ios_base::binary)) {
+		// LCOV_EXCL_START
+		fatal("Failed to create \"%s\": %s", output.c_str(path), strerror(errno));
+		// LCOV_EXCL_STOP
+	}
+	if (!output.writeAll(data)) {
+		// LCOV_EXCL_START
+		fatal("Failed to write \"%s\": %s", output.c_str(path), strerror(errno));
+		// LCOV_EXCL_STOP
+	}
+}
+
 static void outputPalettes(std::vector<Palette> const &palettes) {
 	// LCOV_EXCL_START
 	verboseDo(VERB_INFO, [&]() {
@@ -469,21 +630,17 @@ static void outputPalettes(std::vector<Palette> const &palettes) {
 	}
 
 	if (!options.palettes.empty()) {
-		File output;
-		if (!output.open(options.palettes, std::ios_base::out | std::ios_base::binary)) {
-			// LCOV_EXCL_START
-			fatal("Failed to create \"%s\": %s", output.c_str(options.palettes), strerror(errno));
-			// LCOV_EXCL_STOP
-		}
-
+		std::vector<uint8_t> data;
+		data.reserve(palettes.size() * options.nbColorsPerPal * 2);
 		for (Palette const &palette : palettes) {
 			for (uint8_t i = 0; i < options.nbColorsPerPal; ++i) {
 				// Will output `UINT16_MAX` for unused slots
 				uint16_t color = palette.colors[i];
-				output->sputc(color & 0xFF);
-				output->sputc(color >> 8);
+				data.push_back(color & 0xFF);
+				data.push_back(color >> 8);
 			}
 		}
+		writeOutput(OUTPUT_PALETTES, data);
 	}
 }
 
@@ -624,19 +781,14 @@ static void outputUnoptimizedTileData(
     std::vector<Palette> const &palettes,
     std::vector<size_t> const &mappings
 ) {
-	File output;
-	if (!output.open(options.output, std::ios_base::out | std::ios_base::binary)) {
-		// LCOV_EXCL_START
-		fatal("Failed to create \"%s\": %s", output.c_str(options.output), strerror(errno));
-		// LCOV_EXCL_STOP
-	}
-
 	uint64_t widthTiles = options.inputSlice.width ? options.inputSlice.width : image.png.width / 8;
 	uint64_t heightTiles =
 	    options.inputSlice.height ? options.inputSlice.height : image.png.height / 8;
 	uint64_t nbTiles = widthTiles * heightTiles;
 	uint64_t nbKeptTiles = nbTiles > options.trim ? nbTiles - options.trim : 0;
 	uint64_t tileIdx = 0;
+	std::vector<uint8_t> data;
+	data.reserve(nbKeptTiles * 8 * options.bitDepth);
 
 	for (auto const &[tile, attr] : zip(image.visitAsTiles(), attrmap)) {
 		// Do not emit fully-background tiles.
@@ -655,9 +807,9 @@ static void outputUnoptimizedTileData(
 				empty = false;
 			}
 			if (tileIdx < nbKeptTiles) {
-				output->sputc(bitplanes & 0xFF);
+				data.push_back(bitplanes & 0xFF);
 				if (options.bitDepth == 2) {
-					output->sputc(bitplanes >> 8);
+					data.push_back(bitplanes >> 8);
 				}
 			}
 		}
@@ -671,25 +823,14 @@ static void outputUnoptimizedTileData(
 		++tileIdx;
 	}
 	assume(nbKeptTiles <= tileIdx && tileIdx <= nbTiles);
+
+	writeOutput(OUTPUT_TILES, data);
 }
 
 static void outputUnoptimizedMaps(
     std::vector<AttrmapEntry> const &attrmap, std::vector<size_t> const &mappings
 ) {
-	std::optional<File> tilemapOutput, attrmapOutput, palmapOutput;
-	auto autoOpenPath = [](std::string const &path, std::optional<File> &file) {
-		if (!path.empty()) {
-			file.emplace();
-			if (!file->open(path, std::ios_base::out | std::ios_base::binary)) {
-				// LCOV_EXCL_START
-				fatal("Failed to create \"%s\": %s", file->c_str(path), strerror(errno));
-				// LCOV_EXCL_STOP
-			}
-		}
-	};
-	autoOpenPath(options.tilemap, tilemapOutput);
-	autoOpenPath(options.attrmap, attrmapOutput);
-	autoOpenPath(options.palmap, palmapOutput);
+	std::vector<uint8_t> tilemapData, attrmapData, palmapData;
 
 	uint16_t tileIdx = 0;
 	uint8_t bank = 0;
@@ -701,17 +842,11 @@ static void outputUnoptimizedMaps(
 
 		// The unsigned overflow for `tileID` and `palID` is intentional, since
 		// nonzero base IDs may overflow beyond 255 and continue with IDs from 0.
-		if (tilemapOutput.has_value()) {
-			uint8_t tileID = (attr.isBackgroundTile() ? 0 : tileIdx) + options.baseTileIDs[bank];
-			(*tilemapOutput)->sputc(tileID);
-		}
+		uint8_t tileID = (attr.isBackgroundTile() ? 0 : tileIdx) + options.baseTileIDs[bank];
+		tilemapData.push_back(tileID);
 		uint8_t palID = attr.getPalID(mappings) + options.basePalID;
-		if (attrmapOutput.has_value()) {
-			(*attrmapOutput)->sputc((palID & 0b111) | bank << 3); // The other flags are all 0
-		}
-		if (palmapOutput.has_value()) {
-			(*palmapOutput)->sputc(palID);
-		}
+		attrmapData.push_back((palID & 0b111) | bank << 3); // The other flags are all 0
+		palmapData.push_back(palID);
 
 		// Background tiles were not emitted in the tile data, so their ID and bank do not update.
 		if (attr.isBackgroundTile()) {
@@ -725,6 +860,16 @@ static void outputUnoptimizedMaps(
 			tileIdx = 0;
 		}
 	}
+
+	if (!options.tilemap.empty()) {
+		writeOutput(OUTPUT_TILEMAP, tilemapData);
+	}
+	if (!options.attrmap.empty()) {
+		writeOutput(OUTPUT_ATTRMAP, attrmapData);
+	}
+	if (!options.palmap.empty()) {
+		writeOutput(OUTPUT_PALMAP, palmapData);
+	}
 }
 
 struct UniqueTiles {
@@ -775,26 +920,26 @@ static UniqueTiles dedupTiles(
 		if (!inputTileset.open(options.inputTileset, std::ios::in | std::ios::binary)) {
 			fatal("Failed to open \"%s\": %s", options.inputTileset.c_str(), strerror(errno));
 		}
+		std::vector<uint8_t> const tileset = inputTileset.readAll();
 
-		std::array<uint8_t, 16> tile;
 		size_t const tileSize = options.bitDepth * 8;
-		for (;;) {
-			// It's okay to cast between character types.
-			size_t len = inputTileset->sgetn(reinterpret_cast<char *>(tile.data()), tileSize);
-			if (len == 0) { // EOF!
-				break;
-			} else if (len != tileSize) {
-				fatal(
-				    "\"%s\" does not contain a multiple of %zu bytes; is it actually tile data?",
-				    options.inputTileset.c_str(),
-				    tileSize
-				);
-			} else if (len == 8) {
+		if (tileset.size() % tileSize != 0) {
+			fatal(
+			    "\"%s\" does not contain a multiple of %zu bytes; is it actually tile data?",
+			    options.inputTileset.c_str(),
+			    tileSize
+			);
+		}
+		for (size_t ofs = 0; ofs < tileset.size(); ofs += tileSize) {
+			std::array<uint8_t, 16> tile;
+			if (tileSize == 8) {
 				// Expand the tile data to 2bpp.
-				for (size_t i = 8; i--;) {
+				for (size_t i = 0; i < 8; ++i) {
+					tile[i * 2] = tileset[ofs + i];
 					tile[i * 2 + 1] = 0;
-					tile[i * 2] = tile[i];
 				}
+			} else {
+				std::copy_n(&tileset[ofs], 16, tile.begin());
 			}
 
 			auto [tileID, matchType] = tiles.addTile(std::move(tile));
@@ -842,16 +987,11 @@ static UniqueTiles dedupTiles(
 }
 
 static void outputTileData(UniqueTiles const &tiles) {
-	File output;
-	if (!output.open(options.output, std::ios_base::out | std::ios_base::binary)) {
-		// LCOV_EXCL_START
-		fatal("Failed to create \"%s\": %s", output.c_str(options.output), strerror(errno));
-		// LCOV_EXCL_STOP
-	}
-
 	uint64_t nbTiles = tiles.size();
 	uint64_t nbKeptTiles = nbTiles > options.trim ? nbTiles - options.trim : 0;
 	uint64_t tileIdx = 0;
+	std::vector<uint8_t> data;
+	data.reserve(nbKeptTiles * 8 * options.bitDepth);
 
 	for (TileData const *tile : tiles) {
 		assume(tile->tileID == tileIdx);
@@ -863,9 +1003,9 @@ static void outputTileData(UniqueTiles const &tiles) {
 				empty = false;
 			}
 			if (tileIdx < nbKeptTiles) {
-				output->sputc(bitplane0);
+				data.push_back(bitplane0);
 				if (options.bitDepth == 2) {
-					output->sputc(bitplane1);
+					data.push_back(bitplane1);
 				}
 			}
 		}
@@ -879,54 +1019,44 @@ static void outputTileData(UniqueTiles const &tiles) {
 		++tileIdx;
 	}
 	assume(nbKeptTiles <= tileIdx && tileIdx <= nbTiles);
+
+	writeOutput(OUTPUT_TILES, data);
 }
 
 static void outputTilemap(std::vector<AttrmapEntry> const &attrmap) {
-	File output;
-	if (!output.open(options.tilemap, std::ios_base::out | std::ios_base::binary)) {
-		// LCOV_EXCL_START
-		fatal("Failed to create \"%s\": %s", output.c_str(options.tilemap), strerror(errno));
-		// LCOV_EXCL_STOP
-	}
-
+	std::vector<uint8_t> data;
+	data.reserve(attrmap.size());
 	for (AttrmapEntry const &entry : attrmap) {
-		output->sputc(entry.tileID); // The tile ID has already been converted
+		data.push_back(entry.tileID); // The tile ID has already been converted
 	}
+	writeOutput(OUTPUT_TILEMAP, data);
 }
 
 static void
     outputAttrmap(std::vector<AttrmapEntry> const &attrmap, std::vector<size_t> const &mappings) {
-	File output;
-	if (!output.open(options.attrmap, std::ios_base::out | std::ios_base::binary)) {
-		// LCOV_EXCL_START
-		fatal("Failed to create \"%s\": %s", output.c_str(options.attrmap), strerror(errno));
-		// LCOV_EXCL_STOP
-	}
-
+	std::vector<uint8_t> data;
+	data.reserve(attrmap.size());
 	for (AttrmapEntry const &entry : attrmap) {
 		uint8_t attr = entry.xFlip << 5 | entry.yFlip << 6;
 		attr |= entry.bank << 3;
 		// The unsigned underflow for the palette ID is intentional, since a
 		// nonzero base palette ID may overflow and continue with IDs from 0.
 		attr |= (entry.getPalID(mappings) + options.basePalID) & 0b111;
-		output->sputc(attr);
+		data.push_back(attr);
 	}
+	writeOutput(OUTPUT_ATTRMAP, data);
 }
 
 static void
     outputPalmap(std::vector<AttrmapEntry> const &attrmap, std::vector<size_t> const &mappings) {
-	File output;
-	if (!output.open(options.palmap, std::ios_base::out | std::ios_base::binary)) {
-		// LCOV_EXCL_START
-		fatal("Failed to create \"%s\": %s", output.c_str(options.palmap), strerror(errno));
-		// LCOV_EXCL_STOP
-	}
-
+	std::vector<uint8_t> data;
+	data.reserve(attrmap.size());
 	for (AttrmapEntry const &entry : attrmap) {
 		// The unsigned underflow for the palette ID is intentional, since a
 		// nonzero base palette ID may overflow and continue with IDs from 0.
-		output->sputc(entry.getPalID(mappings) + options.basePalID);
+		data.push_back(entry.getPalID(mappings) + options.basePalID);
 	}
+	writeOutput(OUTPUT_PALMAP, data);
 }
 
 void processPalettes() {
@@ -980,11 +1110,34 @@ void process() {
 		}
 	}
 
+	std::optional<CacheKey> cacheKey;
+	if (!options.cacheDir.empty()) {
+		cacheKey = computeCacheKey(image.png);
+		if (!cacheKey) {
+			verbosePrint(VERB_NOTICE, "Inputs cannot be read, not using the cache\n");
+		} else if (std::optional<CachedOutputs> outputs = loadFromCache(*cacheKey); outputs) {
+			verbosePrint(
+			    VERB_NOTICE,
+			    "Restoring outputs from cache entry %016" PRIx64 "...\n",
+			    cacheKey->hash
+			);
+			for (size_t i = 0; i < outputs->size(); ++i) {
+				if ((*outputs)[i].has_value()) {
+					writeOutput(static_cast<CachedOutput>(i), *(*outputs)[i]);
+				}
+			}
+			return;
+		} else {
+			outputsToCache.emplace();
+			nbDiagnosticsBeforeConversion = getNbDiagnostics();
+		}
+	}
+
 	// Now, iterate through the tiles, generating color sets as we go
 	// We do this unconditionally because this performs the image validation (which we want to
 	// perform even if no output is requested), and because it's necessary to generate any
 	// output (with the exception of an un-duplicated tilemap, but that's an acceptable loss.)
-	std::vector<ColorSet> colorSets;
+	ColorSetCollection collection;
 	std::vector<AttrmapEntry> attrmap{};
 
 	for (auto tile : image.visitAsTiles()) {
@@ -1039,80 +1192,58 @@ void process() {
 		}
 
 		// Insert the color set, making sure to avoid overlaps
-		for (size_t n = 0; n < colorSets.size(); ++n) {
-			switch (colorSet.compare(colorSets[n])) {
-			case ColorSet::STRICT_SUPERSET:
-				// Override the previous color set that this one is a strict superset of
-
-				verbosePrint(
-				    VERB_DEBUG,
-				    "- Tile (%" PRIu32 ", %" PRIu32
-				    ") overrides color set #%zu: [%s] becomes [%s]\n",
-				    tile.x,
-				    tile.y,
-				    n,
-				    listCGBColors(colorSets[n]).c_str(),
-				    listCGBColors(colorSet).c_str()
-				);
+		if (std::optional<size_t> superset = collection.findSuperset(colorSet); superset) {
+			// Use the previous color set that this one is a subset or duplicate of
+			attrs.colorSetID = *superset;
+			continue;
+		}
 
-				colorSets[n] = colorSet;
-				// Remove any other color sets that we are also a strict superset of
-				// (example: we have [(0, 1), (0, 2)] and are inserting (0, 1, 2))
-				for (size_t m = n + 1; m < colorSets.size();) {
-					if (colorSet.compare(colorSets[m]) != ColorSet::STRICT_SUPERSET) {
-						++m;
-					} else {
-						// We are about to remove a set, which will shift sets that may be
-						// already referenced in the attrmap: re-number to keep it consistent
-						for (size_t i = 0; i + 1 < attrmap.size(); ++i) {
-							AttrmapEntry &entry = attrmap[i];
-							if (entry.colorSetID == AttrmapEntry::transparent
-							    || entry.colorSetID == AttrmapEntry::background) {
-								continue;
-							}
-							if (entry.colorSetID == m) {
-								entry.colorSetID = n;
-							} else if (entry.colorSetID > m) {
-								--entry.colorSetID;
-							}
-						}
-						colorSets.erase(colorSets.begin() + m);
-					}
-				}
-				[[fallthrough]];
+		if (std::vector<size_t> subsets = collection.findStrictSubsets(colorSet);
+		    !subsets.empty()) {
+			// Override the first previous color set that this one is a strict superset of
+			size_t n = subsets[0];
 
-			case ColorSet::SUBSET_OR_EQUAL:
-				// Use the previous color set that this one is a subset or duplicate of
-				attrs.colorSetID = n;
-				goto continue_visiting_tiles; // Can't `continue` from within a nested loop
+			verbosePrint(
+			    VERB_DEBUG,
+			    "- Tile (%" PRIu32 ", %" PRIu32 ") overrides color set #%zu: [%s] becomes [%s]\n",
+			    tile.x,
+			    tile.y,
+			    collection.idOf(n),
+			    listCGBColors(collection[n]).c_str(),
+			    listCGBColors(colorSet).c_str()
+			);
 
-			case ColorSet::INCOMPARABLE:
-				// This color set is incomparable so far, so keep going
-				break;
+			collection.replace(n, colorSet);
+			// Remove any other color sets that we are also a strict superset of
+			// (example: we have [(0, 1), (0, 2)] and are inserting (0, 1, 2));
+			// the attrmap entries referencing them are re-numbered once all tiles are visited
+			for (size_t i = 1; i < subsets.size(); ++i) {
+				collection.merge(subsets[i], n);
 			}
+			attrs.colorSetID = n;
+			continue;
 		}
 
 		// This color set is incomparable with all previous ones, so add it as a new one
 
-		if (colorSets.size() == AttrmapEntry::background) { // Check for overflow
-			fatal("Cannot create more than %zu color sets", colorSets.size());
+		if (collection.nbSlots() == AttrmapEntry::background) { // Check for overflow
+			fatal("Cannot create more than %zu color sets", collection.nbSlots());
 		}
 
-		attrs.colorSetID = colorSets.size();
-		colorSets.push_back(colorSet);
+		attrs.colorSetID = collection.add(colorSet);
 
 		verbosePrint(
 		    VERB_DEBUG,
 		    "- Tile (%" PRIu32 ", %" PRIu32 ") adds color set #%zu: [%s]\n",
 		    tile.x,
 		    tile.y,
-		    attrs.colorSetID,
+		    collection.idOf(attrs.colorSetID),
 		    listCGBColors(colorSet).c_str()
 		);
-
-continue_visiting_tiles:;
 	}
 
+	std::vector<ColorSet> colorSets = collection.compact(attrmap);
+
 	verbosePrint(
 	    VERB_INFO,
 	    "Image contains %zu color set%s\n",
@@ -1207,4 +1338,14 @@ continue_visiting_tiles:;
 			outputPalmap(attrmap, mappings);
 		}
 	}
+
+	if (outputsToCache
+	    && (warnings.nbErrors != 0 || getNbDiagnostics() != nbDiagnosticsBeforeConversion)) {
+		verbosePrint(VERB_NOTICE, "Diagnostics were printed, not storing outputs in cache\n");
+	} else if (outputsToCache) {
+		verbosePrint(
+		    VERB_NOTICE, "Storing outputs in cache entry %016" PRIx64 "...\n", cacheKey->hash
+		);
+		storeInCache(*cacheKey, *outputsToCache);
+	}
 }
@@ -4,10 +4,13 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
 #include <errno.h>
 #include <inttypes.h>
 #include <ios>
 #include <math.h>
+#include <mutex>
 #include <optional>
 #include <png.h>
 #include <pngconf.h>
@@ -15,6 +18,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -28,35 +32,28 @@
 #include "gfx/rgba.hpp"
 #include "gfx/warning.hpp"
 
+// Spreads the bits of a bitplane byte into the low bit of each byte, leftmost pixel first
+static std::array<uint64_t, 256> const bitplaneTable = ([]() constexpr {
+	std::array<uint64_t, 256> table{};
+	for (uint16_t i = 0; i < table.size(); ++i) {
+		for (uint8_t x = 0; x < 8; ++x) {
+			if (i & (0x80 >> x)) {
+				table[i] |= static_cast<uint64_t>(1) << (x * 8);
+			}
+		}
+	}
+	return table;
+})();
+
+// How many bytes of pixels each decoding thread produces at once
+static constexpr size_t bandSize = 256 * 1024;
+
 static std::vector<uint8_t> readInto(std::string const &path) {
 	File file;
 	if (!file.open(path, std::ios::in | std::ios::binary)) {
 		fatal("Failed to open \"%s\": %s", file.c_str(path), strerror(errno));
 	}
-	std::vector<uint8_t> data(128 * 16); // Begin with some room pre-allocated
-
-	size_t curSize = 0;
-	for (;;) {
-		size_t oldSize = curSize;
-		curSize = data.size();
-
-		// Fill the new area ([oldSize; curSize[) with bytes
-		size_t nbRead =
-		    file->sgetn(reinterpret_cast<char *>(&data.data()[oldSize]), curSize - oldSize);
-		if (nbRead != curSize - oldSize) {
-			// Shrink the vector to discard bytes that weren't read
-			data.resize(oldSize + nbRead);
-			break;
-		}
-		// If the vector has some capacity left, use it; otherwise, double the current size
-
-		// Arbitrary, but if you got a better idea...
-		size_t newSize = oldSize != data.capacity() ? data.capacity() : oldSize * 2;
-		assume(oldSize != newSize);
-		data.resize(newSize);
-	}
-
-	return data;
+	return file.readAll();
 }
 
 [[noreturn]]
@@ -487,6 +484,14 @@ void reverse() {
 	    PNG_FILTER_TYPE_DEFAULT
 	);
 
+	if (options.compressionLevel.has_value()) {
+		png_set_compression_level(png, *options.compressionLevel);
+		if (*options.compressionLevel == 0) {
+			// Filtering only serves to help compression, so don't waste time on it
+			png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+		}
+	}
+
 	if (pngColorType != PNG_COLOR_TYPE_GRAY) {
 		png_color_8 sbitChunk;
 		sbitChunk.red = 5;
@@ -527,19 +532,40 @@ void reverse() {
 	// N bits/pixel * 8 pixels/tile row / 8 bits/byte = N bytes/tile row
 	uint8_t const bytesPerTileRow = pngColorType == PNG_COLOR_TYPE_RGB_ALPHA ? 32 : pngDepth;
 	size_t const bytesPerRow = width * bytesPerTileRow;
-	std::vector<uint8_t> tileRow(8 * bytesPerRow, 0xFF); // Data for 8 rows of pixels
-	uint8_t * const rowPtrs[8] = {
-	    &tileRow.data()[0 * bytesPerRow],
-	    &tileRow.data()[1 * bytesPerRow],
-	    &tileRow.data()[2 * bytesPerRow],
-	    &tileRow.data()[3 * bytesPerRow],
-	    &tileRow.data()[4 * bytesPerRow],
-	    &tileRow.data()[5 * bytesPerRow],
-	    &tileRow.data()[6 * bytesPerRow],
-	    &tileRow.data()[7 * bytesPerRow],
+
+	// Resolve each palette's colors to their output bytes once, instead of once per pixel
+	struct OutputPalette {
+		std::array<std::array<uint8_t, 4>, 4> rgba;
+		std::array<uint8_t, 4> gray;
+		uint8_t definedMask; // Bit N is set if color #N is defined
+	};
+	std::vector<OutputPalette> outputPalettes(palettes.size());
+	for (size_t i = 0; i < palettes.size(); ++i) {
+		OutputPalette &outPal = outputPalettes[i];
+		outPal.definedMask = 0;
+		for (uint8_t colorID = 0; colorID < 4; ++colorID) {
+			std::optional<Rgba> const &color = palettes[i][colorID];
+			if (!color.has_value()) {
+				outPal.rgba[colorID] = {};
+				outPal.gray[colorID] = 0;
+				continue;
+			}
+			outPal.definedMask |= 1 << colorID;
+			outPal.rgba[colorID] = {color->red, color->green, color->blue, color->alpha};
+			outPal.gray[colorID] = color->red & ((1 << pngDepth) - 1);
+		}
+	}
+
+	// A color referenced by a tile, but absent from its palette
+	struct MissingColor {
+		size_t tx;
+		size_t ty;
+		uint8_t colorID;
 	};
 
-	for (size_t ty = 0; ty < height; ++ty) {
+	// Decodes a row of tiles into 8 rows of pixels.
+	// Only reads shared state, so that several rows can be decoded concurrently.
+	auto decodeTileRow = [&](size_t ty, uint8_t *rows) -> std::optional<MissingColor> {
 		for (size_t tx = 0; tx < width; ++tx) {
 			size_t index = options.columnMajor ? ty + tx * height : ty * width + tx;
 			// By default, a tile is unflipped, in bank 0, and uses palette #0
@@ -562,7 +588,7 @@ void reverse() {
 			static std::array<uint8_t, 16> const trimmedTile{0x00};
 			uint8_t const *tileData =
 			    tileOfs >= nbTiles ? trimmedTile.data() : &tiles[tileOfs * tileSize];
-			auto const &palette = palettes[palOfs];
+			OutputPalette const &palette = outputPalettes[palOfs];
 			for (uint8_t y = 0; y < 8; ++y) {
 				// If vertically mirrored, fetch the bytes from the other end
 				uint8_t realY = (attribute & 0x40 ? 7 - y : y) * options.bitDepth;
@@ -572,60 +598,160 @@ void reverse() {
 					bitplane0 = flipTable[bitplane0];
 					bitplane1 = flipTable[bitplane1];
 				}
+				// Byte N holds the color ID of the Nth pixel from the left
+				uint64_t colorIDs = bitplaneTable[bitplane0] | bitplaneTable[bitplane1] << 1;
 
-				uint8_t *ptr = &rowPtrs[y][tx * bytesPerTileRow];
-				uint16_t gray = 0;
+				uint8_t usedMask = 0;
 				for (uint8_t x = 0; x < 8; ++x) {
-					uint8_t bit0 = bitplane0 & 0x80, bit1 = bitplane1 & 0x80;
-					uint8_t colorID = bit0 >> 7 | bit1 >> 6;
-
-					std::optional<Rgba> const &color = palette[colorID];
-					// Unlike most of the inconsistency checks above, this one is simpler to handle
-					// here in the main loop, since checking each pixel beforehand would duplicate
-					// much of the logic.
-					if (!color.has_value()) {
-						fatal(
-						    "Tile at (%zu, %zu) references color #%" PRIu8
-						    ", but there %s only %" PRIu8 " color%s per palette",
-						    tx,
-						    ty,
-						    colorID,
-						    options.nbColorsPerPal == 1 ? "is" : "are",
-						    options.nbColorsPerPal,
-						    options.nbColorsPerPal == 1 ? "" : "s"
-						);
+					usedMask |= 1 << (colorIDs >> (x * 8) & 0b11);
+				}
+				// Unlike most of the inconsistency checks above, this one is simpler to handle
+				// here in the main loop, since checking each pixel beforehand would duplicate
+				// much of the logic.
+				if (uint8_t missing = usedMask & ~palette.definedMask; missing != 0) {
+					// Report the leftmost missing color, like a pixel-by-pixel scan would
+					for (uint8_t x = 0; x < 8; ++x) {
+						uint8_t colorID = colorIDs >> (x * 8) & 0b11;
+						if (missing & (1 << colorID)) {
+							return MissingColor{.tx = tx, .ty = ty, .colorID = colorID};
+						}
 					}
+				}
 
-					if (Rgba const &pixel = *color; pngColorType == PNG_COLOR_TYPE_GRAY) {
-						gray = gray << pngDepth | (pixel.red & ((1 << pngDepth) - 1));
-					} else if (pngColorType == PNG_COLOR_TYPE_PALETTE) {
-						*ptr++ = palOfs * 4 + colorID;
+				uint8_t *ptr = &rows[y * bytesPerRow + tx * bytesPerTileRow];
+				if (pngColorType == PNG_COLOR_TYPE_GRAY) {
+					uint16_t gray = 0;
+					for (uint8_t x = 0; x < 8; ++x) {
+						gray = gray << pngDepth | palette.gray[colorIDs >> (x * 8) & 0b11];
+					}
+					if (pngDepth == 1) {
+						*ptr = gray;
 					} else {
-						*ptr++ = pixel.red;
-						*ptr++ = pixel.green;
-						*ptr++ = pixel.blue;
-						*ptr++ = pixel.alpha;
+						*ptr++ = gray >> 8;
+						*ptr = gray & 0xff;
+					}
+				} else if (pngColorType == PNG_COLOR_TYPE_PALETTE) {
+					for (uint8_t x = 0; x < 8; ++x) {
+						*ptr++ = palOfs * 4 + (colorIDs >> (x * 8) & 0b11);
+					}
+				} else {
+					for (uint8_t x = 0; x < 8; ++x) {
+						memcpy(ptr, palette.rgba[colorIDs >> (x * 8) & 0b11].data(), 4);
+						ptr += 4;
 					}
+				}
+			}
+		}
+		return std::nullopt;
+	};
 
-					// Shift the pixel out
-					bitplane0 <<= 1;
-					bitplane1 <<= 1;
+	// Tile rows are decoded in bands by worker threads, while this thread compresses the bands
+	// in order as soon as they are ready. At most `nbSlots` bands are in flight at any time, to
+	// keep memory usage bounded regardless of the image's size.
+	size_t const tileRowsPerBand = std::max<size_t>(1, bandSize / (8 * bytesPerRow));
+	size_t const nbBands = (height + tileRowsPerBand - 1) / tileRowsPerBand;
+	size_t const nbWorkers =
+	    std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), nbBands);
+	size_t const nbSlots = nbWorkers * 2;
+
+	struct Band {
+		size_t index = SIZE_MAX; // Which band's data this slot currently holds
+		std::vector<uint8_t> pixels;
+		std::optional<MissingColor> missingColor;
+	};
+	std::vector<Band> slots(nbSlots);
+	std::mutex mutex;
+	std::condition_variable bandsChanged;
+	size_t nbBandsWritten = 0;
+	bool aborted = false;
+	std::atomic<size_t> nextBand = 0;
+
+	std::vector<std::thread> workers;
+	workers.reserve(nbWorkers);
+	for (size_t i = 0; i < nbWorkers; ++i) {
+		workers.emplace_back([&]() {
+			for (size_t band; (band = nextBand++) < nbBands;) {
+				Band &slot = slots[band % nbSlots];
+				{
+					// Wait for the band previously held by this slot to have been written
+					std::unique_lock lock(mutex);
+					bandsChanged.wait(lock, [&]() {
+						return aborted || band < nbBandsWritten + nbSlots;
+					});
+					if (aborted) {
+						return;
+					}
 				}
 
-				if (pngDepth == 1) {
-					*ptr = gray;
-				} else if (pngDepth == 2) {
-					*ptr++ = gray >> 8;
-					*ptr = gray & 0xff;
+				size_t firstTileRow = band * tileRowsPerBand;
+				size_t nbTileRows = std::min(tileRowsPerBand, height - firstTileRow);
+				slot.pixels.resize(nbTileRows * 8 * bytesPerRow);
+				slot.missingColor = std::nullopt;
+				for (size_t row = 0; row < nbTileRows; ++row) {
+					slot.missingColor =
+					    decodeTileRow(firstTileRow + row, &slot.pixels[row * 8 * bytesPerRow]);
+					if (slot.missingColor) {
+						break;
+					}
+				}
+
+				{
+					std::lock_guard lock(mutex);
+					slot.index = band;
 				}
+				bandsChanged.notify_all();
 			}
+		});
+	}
+
+	auto joinWorkers = [&]() {
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+	};
+
+	std::vector<uint8_t *> rowPtrs;
+	for (size_t band = 0; band < nbBands; ++band) {
+		Band &slot = slots[band % nbSlots];
+		{
+			std::unique_lock lock(mutex);
+			bandsChanged.wait(lock, [&]() { return slot.index == band; });
+		}
+
+		// Bands are processed in order, so this is the first missing color in the image
+		if (slot.missingColor) {
+			{
+				std::lock_guard lock(mutex);
+				aborted = true;
+			}
+			bandsChanged.notify_all();
+			joinWorkers();
+
+			fatal(
+			    "Tile at (%zu, %zu) references color #%" PRIu8
+			    ", but there %s only %" PRIu8 " color%s per palette",
+			    slot.missingColor->tx,
+			    slot.missingColor->ty,
+			    slot.missingColor->colorID,
+			    options.nbColorsPerPal == 1 ? "is" : "are",
+			    options.nbColorsPerPal,
+			    options.nbColorsPerPal == 1 ? "" : "s"
+			);
+		}
+
+		rowPtrs.clear();
+		for (size_t ofs = 0; ofs < slot.pixels.size(); ofs += bytesPerRow) {
+			rowPtrs.push_back(&slot.pixels[ofs]);
+		}
+		png_write_rows(png, rowPtrs.data(), rowPtrs.size());
+
+		{
+			std::lock_guard lock(mutex);
+			nbBandsWritten = band + 1;
 		}
-		// We never modify the pointers, and neither should libpng, despite the overly lax function
-		// signature.
-		// (AIUI, casting away const-ness is okay as long as you don't actually modify the
-		// pointed-to data)
-		png_write_rows(png, const_cast<uint8_t **>(rowPtrs), 8);
+		bandsChanged.notify_all();
 	}
+	joinWorkers();
 
 	// Finalize the write
 	png_write_end(png, pngInfo);
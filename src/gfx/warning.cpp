@@ -27,6 +27,8 @@ Diagnostics<WarningLevel, WarningID> warnings = {
 };
 // clang-format on
 
+static uint64_t nbDiagnostics = 0;
+
 [[noreturn]]
 void giveUp() {
 	style_Set(stderr, STYLE_RED, true);
@@ -46,6 +48,10 @@ void requireZeroErrors() {
 	}
 }
 
+uint64_t getNbDiagnostics() {
+	return nbDiagnostics;
+}
+
 void error(char const *fmt, ...) {
 	va_list args;
 	va_start(args, fmt);
@@ -53,6 +59,7 @@ void error(char const *fmt, ...) {
 	va_end(args);
 
 	warnings.incrementErrors();
+	++nbDiagnostics;
 }
 
 [[noreturn]]
@@ -75,4 +82,7 @@ void warning(WarningID id, char const *fmt, ...) {
 	if (behavior == WarningBehavior::ERROR) {
 		warnings.incrementErrors();
 	}
+	if (behavior != WarningBehavior::DISABLED) {
+		++nbDiagnostics;
+	}
 }
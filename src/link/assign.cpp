@@ -15,6 +15,7 @@
 #include "helpers.hpp"
 #include "itertools.hpp"
 #include "linkdefs.hpp"
+#include "profile.hpp"
 #include "verbosity.hpp"
 
 #include "link/main.hpp"
@@ -418,7 +419,10 @@ static void checkOverlayCompat() {
 	);
 }
 
+static ProfilePhase assignmentPhase("assignment");
+
 void assign_AssignSections() {
+	ProfileScope scope(assignmentPhase);
 	verbosePrint(VERB_NOTICE, "Beginning assignment...\n");
 
 	// Initialize the free space-modelling structs
@@ -464,3 +468,7 @@ void assign_AssignSections() {
 
 	assume(nbSectionsToAssign == 0);
 }
+
+void assign_RestoreSection(Section &section, uint32_t bank, uint16_t org) {
+	assignSection(section, {.address = org, .bank = bank});
+}
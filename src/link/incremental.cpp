@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: MIT
+
+#include "link/incremental.hpp"
+
+#include <algorithm>
+#include <array>
+#include <errno.h>
+#include <filesystem>
+#include <ios>
+#include <optional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "file.hpp"
+#include "hash.hpp"
+#include "helpers.hpp" // RANGE
+#include "linkdefs.hpp"
+#include "verbosity.hpp"
+#include "version.hpp"
+
+#include "link/assign.hpp"
+#include "link/main.hpp"
+#include "link/object.hpp"
+#include "link/section.hpp"
+#include "link/symbol.hpp"
+
+// Bumped whenever the layout of state files changes
+static std::array<uint8_t, 8> const stateMagic{'R', 'G', 'B', 'L', 'I', 'N', 'K', 1};
+
+struct Object {
+	std::vector<Symbol> const *symbols;
+	size_t fileID;
+};
+
+struct Placement {
+	uint32_t bank;
+	uint16_t org;
+};
+
+static std::vector<Object> objects;
+static bool readsStdin = false;
+static bool isPossible = true;
+static uint64_t key;
+static std::vector<uint64_t> prevHashes;
+
+static bool reusingOutput = false;
+static bool rom0Dirty = false;
+static std::vector<bool> dirtyRomxBanks;
+static std::vector<uint16_t> bankSums;
+
+template<typename T>
+static void writeInt(std::vector<uint8_t> &state, T value) {
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		state.push_back(static_cast<uint64_t>(value) >> (i * 8));
+	}
+}
+
+template<typename T>
+static bool readInt(std::vector<uint8_t> const &state, size_t &ofs, T &value) {
+	if (state.size() - ofs < sizeof(T)) {
+		return false;
+	}
+	uint64_t bytes = 0;
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		bytes |= static_cast<uint64_t>(state[ofs++]) << (i * 8);
+	}
+	value = static_cast<T>(bytes);
+	return true;
+}
+
+static bool isFixingHeader() {
+	return options.fixHeader || options.title || options.mbcType;
+}
+
+void incr_AddObject(
+    std::string const &path, size_t fileID, std::vector<Symbol> const &fileSymbols
+) {
+	if (!options.stateFileName) {
+		return;
+	}
+
+	// Standard input may differ from one link to the next, even if its hash does not
+	if (path == "-") {
+		readsStdin = true;
+	}
+	objects.push_back({.symbols = &fileSymbols, .fileID = fileID});
+}
+
+static char const *whyImpossible() {
+	if (!options.outputFileName || *options.outputFileName == "-") {
+		return "without an output file";
+	} else if (options.overlayFileName) {
+		return "with an overlay file";
+	} else if (options.disablePadding) {
+		return "without padding";
+	} else if (readsStdin) {
+		return "when reading objects from standard input";
+	}
+	return nullptr;
+}
+
+// Hashes everything that section placement and the output's contents depend on, except for the
+// contents of the objects themselves
+static uint64_t computeKey() {
+	static Hasher hasher; // `static` so `sect_ForEach` callback can see it
+
+	hasher.add(std::string(get_package_version_string()));
+	hasher.add(*options.outputFileName);
+	hasher.add(options.isDmgMode);
+	hasher.add(options.padValue);
+	hasher.add(options.scrambleROMX);
+	hasher.add(options.scrambleWRAMX);
+	hasher.add(options.scrambleSRAM);
+	hasher.add(options.is32kMode);
+	hasher.add(options.isWRAM0Mode);
+	hasher.add(options.fixHeader);
+	hasher.add(options.mbcType.has_value());
+	hasher.add(options.mbcType.value_or(0));
+	hasher.add(options.title.has_value());
+	hasher.add(options.title.value_or(""));
+	hasher.add(objects.size());
+
+	// Assignment only depends on sections' sizes and constraints, and on the order of sections
+	sect_ForEach([](Section &section) {
+		hasher.add(section.name);
+		hasher.add(static_cast<uint8_t>(section.type));
+		hasher.add(static_cast<uint8_t>(section.modifier));
+		hasher.add(section.size);
+		hasher.add(section.isAddressFixed);
+		if (section.isAddressFixed) {
+			hasher.add(section.org);
+		}
+		hasher.add(section.isBankFixed);
+		if (section.isBankFixed) {
+			hasher.add(section.bank);
+		}
+		hasher.add(section.isAlignFixed);
+		if (section.isAlignFixed) {
+			hasher.add(section.alignMask);
+			hasher.add(section.alignOfs);
+		}
+		for (Section const &piece : section.pieces()) {
+			hasher.add(piece.size);
+			hasher.add(piece.offset);
+		}
+	});
+
+	return hasher.value();
+}
+
+static std::optional<std::pair<uint64_t, int64_t>> statOutput() {
+	std::error_code error;
+	uint64_t size = std::filesystem::file_size(*options.outputFileName, error);
+	if (error) {
+		return std::nullopt;
+	}
+	std::filesystem::file_time_type time =
+	    std::filesystem::last_write_time(*options.outputFileName, error);
+	if (error) {
+		return std::nullopt;
+	}
+	return std::pair{size, static_cast<int64_t>(time.time_since_epoch().count())};
+}
+
+static void markDirty(Section const &section) {
+	if (section.type == SECTTYPE_ROM0) {
+		rom0Dirty = true;
+		return;
+	}
+	assume(section.type == SECTTYPE_ROMX);
+	uint32_t bank = section.bank - sectionTypeInfo[SECTTYPE_ROMX].firstBank;
+	if (dirtyRomxBanks.size() <= bank) {
+		dirtyRomxBanks.resize(bank + 1);
+	}
+	dirtyRomxBanks[bank] = true;
+}
+
+// Objects that changed, or that import anything from one that did, have to be patched again
+static std::unordered_set<std::vector<Symbol> const *> findDirtyObjects() {
+	std::unordered_set<std::vector<Symbol> const *> dirtyObjects;
+	std::unordered_set<Symbol const *> changedExports;
+
+	for (size_t i = 0; i < objects.size(); ++i) {
+		if (obj_GetHash(objects[i].fileID) == prevHashes[i]) {
+			continue;
+		}
+		dirtyObjects.insert(objects[i].symbols);
+		for (Symbol const &sym : *objects[i].symbols) {
+			if (sym.type == SYMTYPE_EXPORT) {
+				changedExports.insert(&sym);
+			}
+		}
+	}
+
+	if (!changedExports.empty()) {
+		for (Object const &object : objects) {
+			for (Symbol const &sym : *object.symbols) {
+				if (sym.type == SYMTYPE_IMPORT && changedExports.contains(sym.definition)) {
+					dirtyObjects.insert(object.symbols);
+					break;
+				}
+			}
+		}
+	}
+
+	return dirtyObjects;
+}
+
+bool incr_RestorePlacement() {
+	if (!options.stateFileName) {
+		return false;
+	}
+	if (char const *reason = whyImpossible(); reason) {
+		warnx("Incremental linking is not possible %s; linking from scratch", reason);
+		isPossible = false;
+		return false;
+	}
+
+	key = computeKey();
+
+	File file;
+	if (!file.open(*options.stateFileName, std::ios_base::in | std::ios_base::binary)) {
+		verbosePrint(VERB_NOTICE, "No previous link state, linking from scratch\n");
+		return false;
+	}
+	std::vector<uint8_t> state = file.readAll();
+
+	// Malformed or outdated states are treated as missing, and will be overwritten
+	size_t ofs = stateMagic.size();
+	uint64_t prevKey, prevRomSize;
+	int64_t prevRomTime;
+	if (state.size() < stateMagic.size() || !std::equal(RANGE(stateMagic), state.begin())
+	    || !readInt(state, ofs, prevKey) || prevKey != key || !readInt(state, ofs, prevRomSize)
+	    || !readInt(state, ofs, prevRomTime)) {
+		verbosePrint(VERB_NOTICE, "Sections or options changed, linking from scratch\n");
+		return false;
+	}
+	// Banks are only rewritten in place if the rest of the ROM is still what was written last
+	if (std::optional<std::pair<uint64_t, int64_t>> stat = statOutput();
+	    !stat || stat->first != prevRomSize || stat->second != prevRomTime) {
+		verbosePrint(VERB_NOTICE, "Output changed since last link, linking from scratch\n");
+		return false;
+	}
+
+	uint32_t nbObjects;
+	if (!readInt(state, ofs, nbObjects) || nbObjects != objects.size()) {
+		return false;
+	}
+	prevHashes.resize(nbObjects);
+	for (uint64_t &hash : prevHashes) {
+		if (!readInt(state, ofs, hash)) {
+			return false;
+		}
+	}
+
+	uint32_t nbSections;
+	if (!readInt(state, ofs, nbSections)) {
+		return false;
+	}
+	// `static` so `sect_ForEach` callback can see it
+	static std::vector<Placement> placements;
+	placements.resize(nbSections);
+	for (Placement &placement : placements) {
+		if (!readInt(state, ofs, placement.bank) || !readInt(state, ofs, placement.org)) {
+			return false;
+		}
+	}
+
+	uint32_t nbSums;
+	if (!readInt(state, ofs, nbSums)) {
+		return false;
+	}
+	std::vector<uint16_t> prevSums(nbSums);
+	for (uint16_t &sum : prevSums) {
+		if (!readInt(state, ofs, sum)) {
+			return false;
+		}
+	}
+	if (ofs != state.size()) {
+		return false;
+	}
+	bankSums = std::move(prevSums);
+
+	static size_t sectionIdx = 0;
+	sect_ForEach([](Section &section) {
+		assume(sectionIdx < placements.size());
+		assign_RestoreSection(section, placements[sectionIdx].bank, placements[sectionIdx].org);
+		++sectionIdx;
+	});
+	assume(sectionIdx == placements.size());
+
+	verbosePrint(VERB_NOTICE, "Reusing previous placement\n");
+	reusingOutput = true;
+	return true;
+}
+
+void incr_FindDirtyBanks() {
+	if (!reusingOutput) {
+		return;
+	}
+
+	static std::unordered_set<std::vector<Symbol> const *> dirtyObjects;
+	dirtyObjects = findDirtyObjects();
+	sect_ForEach([](Section &section) {
+		if (!sectTypeHasData(section.type)) {
+			return;
+		}
+		for (Section const &piece : section.pieces()) {
+			if (dirtyObjects.contains(piece.fileSymbols)) {
+				markDirty(section);
+				break;
+			}
+		}
+	});
+	// The header's checksums cover the whole ROM
+	if (isFixingHeader() && !dirtyObjects.empty()) {
+		rom0Dirty = true;
+	}
+
+	verbosePrint(
+	    VERB_NOTICE, "%zu of %zu objects need patching\n", dirtyObjects.size(), objects.size()
+	);
+}
+
+bool incr_IsReusingOutput() {
+	return reusingOutput;
+}
+
+bool incr_IsBankDirty(SectionType type, uint32_t bank) {
+	if (!reusingOutput) {
+		return true;
+	} else if (type == SECTTYPE_ROM0) {
+		return rom0Dirty;
+	}
+	return bank < dirtyRomxBanks.size() && dirtyRomxBanks[bank];
+}
+
+uint16_t incr_GetBankSum(uint32_t bank) {
+	assume(bank < bankSums.size());
+	return bankSums[bank];
+}
+
+void incr_SetBankSum(uint32_t bank, uint16_t sum) {
+	if (bankSums.size() <= bank) {
+		bankSums.resize(bank + 1);
+	}
+	bankSums[bank] = sum;
+}
+
+void incr_SaveState() {
+	if (!options.stateFileName || !isPossible) {
+		return;
+	}
+
+	std::optional<std::pair<uint64_t, int64_t>> stat = statOutput();
+	if (!stat) {
+		warnx("Failed to get the output's size and time; not saving the link state");
+		return;
+	}
+
+	// `static` so `sect_ForEach` callback can see it
+	static std::vector<uint8_t> state;
+	state.assign(RANGE(stateMagic));
+	writeInt(state, key);
+	writeInt(state, stat->first);
+	writeInt(state, stat->second);
+
+	writeInt(state, static_cast<uint32_t>(objects.size()));
+	for (Object const &object : objects) {
+		writeInt(state, obj_GetHash(object.fileID));
+	}
+
+	static uint32_t nbSections = 0;
+	sect_ForEach([](Section &) { ++nbSections; });
+	writeInt(state, nbSections);
+	sect_ForEach([](Section &section) {
+		writeInt(state, section.bank);
+		writeInt(state, section.org);
+	});
+
+	writeInt(state, static_cast<uint32_t>(bankSums.size()));
+	for (uint16_t sum : bankSums) {
+		writeInt(state, sum);
+	}
+
+	if (File file; !file.open(*options.stateFileName, std::ios_base::out | std::ios_base::binary)
+	               || !file.writeAll(state)) {
+		warnx(
+		    "Failed to write link state \"%s\": %s", options.stateFileName->c_str(), strerror(errno)
+		);
+	}
+}
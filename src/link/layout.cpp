@@ -6,6 +6,7 @@
 #include <bit>
 #include <inttypes.h>
 #include <stdint.h>
+#include <string_view>
 #include <vector>
 
 #include "helpers.hpp"
@@ -218,16 +219,21 @@ void layout_Pad(uint32_t length) {
 	}
 }
 
-void layout_PlaceSection(std::string const &name, bool isOptional) {
+void layout_PlaceSection(std::string_view name, bool isOptional) {
 	if (activeType == SECTTYPE_INVALID) {
-		scriptError("No memory region has been specified to place section \"%s\" in", name.c_str());
+		scriptError(
+		    "No memory region has been specified to place section \"%" PRI_SV "\" in",
+		    PRI_SV_ARG(name)
+		);
 		return;
 	}
 
-	Section *section = sect_GetSection(name.c_str());
+	// Section names are stored NUL-terminated in object files, so they end at any '\0' escape
+	name = name.substr(0, name.find('\0'));
+	Section *section = sect_GetSection(name);
 	if (!section) {
 		if (!isOptional) {
-			scriptError("Undefined section \"%s\"", name.c_str());
+			scriptError("Undefined section \"%" PRI_SV "\"", PRI_SV_ARG(name));
 		}
 		return;
 	}
@@ -237,18 +243,18 @@ void layout_PlaceSection(std::string const &name, bool isOptional) {
 	// Check that the linker script doesn't contradict what the code says.
 	if (section->type == SECTTYPE_INVALID) {
 		// A section that has data must get assigned a type that requires data.
-		if (!sectTypeHasData(activeType) && !section->data.empty()) {
+		if (!sectTypeHasData(activeType) && section->hasData()) {
 			scriptError(
 			    "\"%s\" is specified to be a %s section, but it contains data",
-			    name.c_str(),
+			    section->name.c_str(),
 			    typeInfo.name.c_str()
 			);
-		} else if (sectTypeHasData(activeType) && section->data.empty() && section->size != 0) {
+		} else if (sectTypeHasData(activeType) && !section->hasData() && section->size != 0) {
 			// A section that lacks data can only be assigned to a type that requires data
 			// if it's empty.
 			scriptError(
 			    "\"%s\" is specified to be a %s section, but it does not contain data",
-			    name.c_str(),
+			    section->name.c_str(),
 			    typeInfo.name.c_str()
 			);
 		} else {
@@ -260,7 +266,7 @@ void layout_PlaceSection(std::string const &name, bool isOptional) {
 	} else if (section->type != activeType) {
 		scriptError(
 		    "\"%s\" is specified to be a %s section, but it is already a %s section",
-		    name.c_str(),
+		    section->name.c_str(),
 		    typeInfo.name.c_str(),
 		    sectionTypeInfo[section->type].name.c_str()
 		);
@@ -274,7 +280,7 @@ void layout_PlaceSection(std::string const &name, bool isOptional) {
 			scriptError(
 			    "The linker script places section \"%s\" in %s bank %" PRIu32
 			    ", but it was already defined in bank %" PRIu32,
-			    name.c_str(),
+			    section->name.c_str(),
 			    sectionTypeInfo[section->type].name.c_str(),
 			    bank,
 			    section->bank
@@ -290,7 +296,7 @@ void layout_PlaceSection(std::string const &name, bool isOptional) {
 			scriptError(
 			    "The linker script assigns section \"%s\" to address $%04" PRIx16
 			    ", but it was already at $%04" PRIx16,
-			    name.c_str(),
+			    section->name.c_str(),
 			    org,
 			    section->org
 			);
@@ -300,7 +306,7 @@ void layout_PlaceSection(std::string const &name, bool isOptional) {
 			    "The linker script assigns section \"%s\" to address $%04" PRIx16
 			    ", but that would be ALIGN[%" PRIu8 ", %" PRIu16
 			    "] instead of the requested ALIGN[%" PRIu8 ", %" PRIu16 "]",
-			    name.c_str(),
+			    section->name.c_str(),
 			    org,
 			    alignment,
 			    static_cast<uint16_t>(org & section->alignMask),
@@ -318,7 +324,7 @@ void layout_PlaceSection(std::string const &name, bool isOptional) {
 			scriptError(
 			    "The linker script assigns section \"%s\" to address $%04" PRIx16
 			    ", but then it would overflow %s by %" PRIu16 " byte%s",
-			    name.c_str(),
+			    section->name.c_str(),
 			    org,
 			    typeInfo.name.c_str(),
 			    overflowSize,
@@ -2,17 +2,23 @@
 
 #include "link/lexer.hpp"
 
+#include <array>
+#include <deque>
 #include <errno.h>
-#include <fstream>
 #include <ios>
+#include <iterator>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "backtrace.hpp"
+#include "file.hpp"
+#include "helpers.hpp" // PRI_SV
 #include "linkdefs.hpp"
 #include "util.hpp"
 
@@ -20,13 +26,45 @@
 // Include this last so it gets all type & constant definitions
 #include "script.hpp" // For token definitions, generated from script.y
 
+// Each file is read only once, however many times it gets `INCLUDE`d.
+// Tokens are views of these contents, so they are kept until the program exits.
+static std::unordered_map<std::string, std::vector<uint8_t>> fileContents;
+// Strings that contained escape sequences cannot be views of the file contents
+static std::deque<std::string> unescapedStrings;
+
 struct LexerStackEntry {
-	std::filebuf file;
 	std::string path;
+	char const *ptr; // Cursor into the file's contents
+	char const *end;
 	uint32_t lineNo;
 	bool atEof;
 
-	explicit LexerStackEntry(std::string &&path_) : file(), path(path_), lineNo(1), atEof(false) {}
+	explicit LexerStackEntry(std::string &&path_)
+	    : path(path_), ptr(nullptr), end(nullptr), lineNo(1), atEof(false) {}
+
+	bool open() {
+		auto search = fileContents.find(path);
+		if (search == fileContents.end()) {
+			File file;
+			if (!file.open(path, std::ios_base::in)) {
+				return false;
+			}
+			search = fileContents.emplace(path, file.readAll()).first;
+		}
+		ptr = reinterpret_cast<char const *>(search->second.data());
+		end = ptr + search->second.size();
+		return true;
+	}
+
+	// These mirror `std::streambuf`'s `sgetc`, `sbumpc`, and `snextc`
+	int peek() const { return ptr != end ? static_cast<uint8_t>(*ptr) : EOF; }
+	int bump() { return ptr != end ? static_cast<uint8_t>(*ptr++) : EOF; }
+	int next() {
+		if (ptr != end) {
+			++ptr;
+		}
+		return peek();
+	}
 };
 
 static std::vector<LexerStackEntry> lexerStack;
@@ -39,13 +77,13 @@ void lexer_TraceCurrent() {
 	);
 }
 
-void lexer_IncludeFile(std::string &&path) {
+void lexer_IncludeFile(std::string_view path) {
 	// `.emplace_back` can invalidate references to the stack's elements!
 	// This is why `newContext` must be gotten before `prevContext`.
-	LexerStackEntry &newContext = lexerStack.emplace_back(std::move(path));
+	LexerStackEntry &newContext = lexerStack.emplace_back(std::string(path));
 	LexerStackEntry &prevContext = lexerStack[lexerStack.size() - 2];
 
-	if (!newContext.file.open(newContext.path, std::ios_base::in)) {
+	if (!newContext.open()) {
 		// `.pop_back()` will invalidate `newContext`, which is why `path` must be moved first.
 		std::string badPath = std::move(newContext.path);
 		lexerStack.pop_back();
@@ -80,14 +118,72 @@ static yy::parser::symbol_type yywrap() {
 	return yylex();
 }
 
-static std::string readKeyword(int initial) {
+// The initial character has already been read
+static std::string_view readKeyword() {
 	LexerStackEntry &context = lexerStack.back();
-	std::string keyword;
-	keyword.push_back(initial);
-	for (int c = context.file.sgetc(); isAlphanumeric(c); c = context.file.snextc()) {
-		keyword.push_back(c);
+	char const *start = context.ptr - 1;
+	while (isAlphanumeric(context.peek())) {
+		++context.ptr;
 	}
-	return keyword;
+	return std::string_view(start, context.ptr - start);
+}
+
+struct Keyword {
+	std::string_view name;
+	yy::parser::symbol_type (*make)(); // `nullptr` for section types
+	SectionType sectType;
+};
+
+// clang-format off: vertically align values
+static constexpr Keyword keywords[] = {
+    {"WRAM0",    nullptr,                   SECTTYPE_WRAM0  },
+    {"VRAM",     nullptr,                   SECTTYPE_VRAM   },
+    {"ROMX",     nullptr,                   SECTTYPE_ROMX   },
+    {"ROM0",     nullptr,                   SECTTYPE_ROM0   },
+    {"HRAM",     nullptr,                   SECTTYPE_HRAM   },
+    {"WRAMX",    nullptr,                   SECTTYPE_WRAMX  },
+    {"SRAM",     nullptr,                   SECTTYPE_SRAM   },
+    {"OAM",      nullptr,                   SECTTYPE_OAM    },
+    {"ORG",      yy::parser::make_ORG,      SECTTYPE_INVALID},
+    {"FLOATING", yy::parser::make_FLOATING, SECTTYPE_INVALID},
+    {"INCLUDE",  yy::parser::make_INCLUDE,  SECTTYPE_INVALID},
+    {"ALIGN",    yy::parser::make_ALIGN,    SECTTYPE_INVALID},
+    {"DS",       yy::parser::make_DS,       SECTTYPE_INVALID},
+    {"OPTIONAL", yy::parser::make_OPTIONAL, SECTTYPE_INVALID},
+};
+// clang-format on
+
+// A perfect hash of the above keywords, which only looks at their ends and length.
+// Clearing bit 5 folds letters' case, and keeps all other characters distinct.
+static constexpr size_t hashKeyword(std::string_view name) {
+	return (((name.front() & ~0x20) << 3) ^ (name.back() & ~0x20) ^ (name.size() << 1)) % 32;
+}
+
+static constexpr std::array<int8_t, 32> keywordSlots = [] {
+	std::array<int8_t, 32> slots;
+	slots.fill(-1);
+	for (size_t i = 0; i < std::size(keywords); ++i) {
+		slots[hashKeyword(keywords[i].name)] = i;
+	}
+	return slots;
+}();
+
+static constexpr bool keywordsHashPerfectly() {
+	for (size_t i = 0; i < std::size(keywords); ++i) {
+		if (keywordSlots[hashKeyword(keywords[i].name)] != static_cast<int8_t>(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+static_assert(keywordsHashPerfectly(), "Keywords' hashes collide");
+
+static Keyword const *findKeyword(std::string_view name) {
+	int8_t slot = keywordSlots[hashKeyword(name)];
+	if (slot == -1 || !Uppercase{}(keywords[slot].name, name)) {
+		return nullptr;
+	}
+	return &keywords[slot];
 }
 
 template<uint32_t Base>
@@ -109,7 +205,7 @@ static yy::parser::symbol_type readNumber(int initial, char const *prefix) {
 
 	bool prevWasSeparator = false;
 
-	for (int c = context.file.sgetc();; c = context.file.snextc()) {
+	for (int c = context.peek();; c = context.next()) {
 		if (c == '_') {
 			if (prevWasSeparator) {
 				scriptError("Invalid integer constant, '_' after another '_'");
@@ -128,8 +224,8 @@ static yy::parser::symbol_type readNumber(int initial, char const *prefix) {
 		if (number > (UINT32_MAX - digit) / Base) {
 			scriptWarning(WARNING_LARGE_CONSTANT, "Integer constant is too large");
 			// Discard any additional digits
-			for (c = context.file.snextc(); isDigit<Base>(c) || c == '_';
-			     c = context.file.snextc()) {}
+			for (c = context.next(); isDigit<Base>(c) || c == '_';
+			     c = context.next()) {}
 			return yy::parser::make_number(0);
 		}
 		number = number * Base + digit;
@@ -147,18 +243,18 @@ static yy::parser::symbol_type readNumber(int initial, char const *prefix) {
 static yy::parser::symbol_type parseAnyNumber(int initial) {
 	LexerStackEntry &context = lexerStack.back();
 	if (initial == '0') {
-		switch (context.file.sgetc()) {
+		switch (context.peek()) {
 		case 'x':
 		case 'X':
-			context.file.sbumpc();
+			context.bump();
 			return readNumber<16>(0, "\"0x\"");
 		case 'o':
 		case 'O':
-			context.file.sbumpc();
+			context.bump();
 			return readNumber<8>(0, "\"0o\"");
 		case 'b':
 		case 'B':
-			context.file.sbumpc();
+			context.bump();
 			return readNumber<2>(0, "\"0b\"");
 		}
 	}
@@ -167,20 +263,33 @@ static yy::parser::symbol_type parseAnyNumber(int initial) {
 
 static yy::parser::symbol_type parseString() {
 	LexerStackEntry &context = lexerStack.back();
-	std::string str;
-	for (int c = context.file.sgetc();; c = context.file.sgetc()) {
+	// Strings without escape sequences are returned as views, only others need to be copied
+	char const *start = context.ptr;
+	std::string *str = nullptr;
+	auto makeString = [&]() {
+		return yy::parser::make_string(
+		    str ? std::string_view(*str) : std::string_view(start, context.ptr - start)
+		);
+	};
+
+	for (int c = context.peek();; c = context.peek()) {
 		if (c == EOF || isNewline(c)) {
 			scriptError("Unterminated string");
-			break;
+			return makeString();
 		}
-		context.file.sbumpc();
 		if (c == '"') {
-			break;
+			yy::parser::symbol_type token = makeString();
+			context.bump();
+			return token;
 		} else if (c == '\\') {
-			c = context.file.sgetc();
+			if (!str) {
+				str = &unescapedStrings.emplace_back(start, context.ptr);
+			}
+			context.bump();
+			c = context.peek();
 			if (c == EOF || isNewline(c)) {
 				scriptError("Unterminated string");
-				break;
+				return makeString();
 			} else if (c == 'n') {
 				c = '\n';
 			} else if (c == 'r') {
@@ -192,25 +301,26 @@ static yy::parser::symbol_type parseString() {
 			} else if (c != '\\' && c != '"' && c != '\'') {
 				scriptError("Cannot escape character %s", printChar(c));
 			}
-			context.file.sbumpc();
 		}
-		str.push_back(c);
+		context.bump();
+		if (str) {
+			str->push_back(c);
+		}
 	}
-	return yy::parser::make_string(std::move(str));
 }
 
 yy::parser::symbol_type yylex() {
 	LexerStackEntry &context = lexerStack.back();
-	int c = context.file.sbumpc();
+	int c = context.bump();
 
 	// First, skip leading blank space.
 	while (isBlankSpace(c)) {
-		c = context.file.sbumpc();
+		c = context.bump();
 	}
 	// Then, skip a comment if applicable.
 	if (c == ';') {
 		while (c != EOF && !isNewline(c)) {
-			c = context.file.sbumpc();
+			c = context.bump();
 		}
 	}
 
@@ -221,8 +331,8 @@ yy::parser::symbol_type yylex() {
 		return yy::parser::make_COMMA();
 	} else if (isNewline(c)) {
 		// Handle CRLF.
-		if (c == '\r' && context.file.sgetc() == '\n') {
-			context.file.sbumpc();
+		if (c == '\r' && context.peek() == '\n') {
+			context.bump();
 		}
 		return yy::parser::make_newline();
 	} else if (c == '"') {
@@ -236,40 +346,20 @@ yy::parser::symbol_type yylex() {
 	} else if (isDigit<10>(c)) {
 		return parseAnyNumber(c);
 	} else if (isLetter(c)) {
-		std::string keyword = readKeyword(c);
-
-		static UpperMap<SectionType> const sectTypes{
-		    {"WRAM0", SECTTYPE_WRAM0},
-		    {"VRAM",  SECTTYPE_VRAM },
-		    {"ROMX",  SECTTYPE_ROMX },
-		    {"ROM0",  SECTTYPE_ROM0 },
-		    {"HRAM",  SECTTYPE_HRAM },
-		    {"WRAMX", SECTTYPE_WRAMX},
-		    {"SRAM",  SECTTYPE_SRAM },
-		    {"OAM",   SECTTYPE_OAM  },
-		};
-		if (auto search = sectTypes.find(keyword); search != sectTypes.end()) {
-			return yy::parser::make_sect_type(search->second);
-		}
+		std::string_view keyword = readKeyword();
 
-		static UpperMap<yy::parser::symbol_type (*)()> const keywords{
-		    {"ORG",      yy::parser::make_ORG     },
-		    {"FLOATING", yy::parser::make_FLOATING},
-		    {"INCLUDE",  yy::parser::make_INCLUDE },
-		    {"ALIGN",    yy::parser::make_ALIGN   },
-		    {"DS",       yy::parser::make_DS      },
-		    {"OPTIONAL", yy::parser::make_OPTIONAL},
-		};
-		if (auto search = keywords.find(keyword); search != keywords.end()) {
-			return search->second();
+		if (Keyword const *search = findKeyword(keyword); search && search->make) {
+			return search->make();
+		} else if (search) {
+			return yy::parser::make_sect_type(search->sectType);
 		}
 
-		scriptError("Unknown keyword `%s`", keyword.c_str());
+		scriptError("Unknown keyword `%" PRI_SV "`", PRI_SV_ARG(keyword));
 		return yylex();
 	} else {
 		scriptError("Unexpected character %s", printChar(c));
 		// Keep reading characters until the EOL, to avoid reporting too many errors.
-		for (c = context.file.sgetc(); c != EOF && !isNewline(c); c = context.file.snextc()) {}
+		for (c = context.peek(); c != EOF && !isNewline(c); c = context.next()) {}
 		return yylex();
 	}
 	// Not marking as unreachable; this will generate a warning if any codepath forgets to return.
@@ -277,7 +367,7 @@ yy::parser::symbol_type yylex() {
 
 bool lexer_Init(std::string const &linkerScriptName) {
 	if (LexerStackEntry &newContext = lexerStack.emplace_back(std::string(linkerScriptName));
-	    !newContext.file.open(newContext.path, std::ios_base::in)) {
+	    !newContext.open()) {
 		error("Failed to open linker script \"%s\"", linkerScriptName.c_str());
 		lexerStack.clear();
 		return false;
@@ -16,6 +16,8 @@
 #include "cli.hpp"
 #include "diagnostics.hpp"
 #include "linkdefs.hpp"
+#include "profile.hpp"
+#include "romheader.hpp" // header_MaxTitleLen
 #include "script.hpp" // Generated from script.y
 #include "style.hpp"  // style_Parse
 #include "usage.hpp"
@@ -23,11 +25,13 @@
 #include "verbosity.hpp"
 
 #include "link/assign.hpp"
+#include "link/incremental.hpp"
 #include "link/lexer.hpp"
 #include "link/object.hpp"
 #include "link/output.hpp"
 #include "link/patch.hpp"
 #include "link/section.hpp"
+#include "link/symbol.hpp"
 #include "link/warning.hpp"
 
 Options options;
@@ -42,7 +46,8 @@ static struct LocalOptions {
 static char const *optstring = "B:dhl:m:Mn:O:o:p:S:tVvW:wx";
 
 // Long-only option variable
-static int longOpt; // `--color`
+// `--color`, `--fix-header`, `--incremental`, `--mbc-type`, `--profile`, `--title`
+static int longOpt;
 
 // Equivalent long options
 // Please keep in the same order as short opts.
@@ -70,6 +75,11 @@ static option const longopts[] = {
     {"wramx",         no_argument,       nullptr,  'w'},
     {"nopad",         no_argument,       nullptr,  'x'},
     {"color",         required_argument, &longOpt, 'c'},
+    {"fix-header",    no_argument,       &longOpt, 'f'},
+    {"incremental",   required_argument, &longOpt, 'i'},
+    {"mbc-type",      required_argument, &longOpt, 'm'},
+    {"profile",       required_argument, &longOpt, 'p'},
+    {"title",         required_argument, &longOpt, 't'},
     {nullptr,         no_argument,       nullptr,  0  },
 };
 
@@ -87,12 +97,17 @@ static Usage usage = {
         {{"-o", "--output <path>"}, {"set the output file"}},
         {{"-p", "--pad <value>"}, {"set the value to pad between sections with"}},
         {{"-x", "--nopad"}, {"disable padding of output binary"}},
+        {{"--fix-header"}, {"fix the header's logo, ROM size, and checksums"}},
+        {{"--mbc-type <value>"}, {"set the cartridge type byte in the header"}},
+        {{"--title <title>"}, {"set the title in the header"}},
         {{"-V", "--version"}, {"print RGBLINK version and exit"}},
         {{"-W", "--warning <warning>"}, {"enable or disable warnings"}},
     },
 };
 // clang-format on
 
+static ProfilePhase linkerScriptPhase("linker script");
+
 static size_t skipBlankSpace(char const *str) {
 	return strspn(str, " \t");
 }
@@ -311,8 +326,48 @@ static void parseArg(int ch, char *arg) {
 		break;
 
 	case 0: // Long-only options
-		if (longOpt == 'c' && !style_Parse(arg)) {
-			fatal("Invalid argument for option '--color'");
+		switch (longOpt) {
+		case 'c':
+			if (!style_Parse(arg)) {
+				fatal("Invalid argument for option '--color'");
+			}
+			break;
+
+		case 'f':
+			options.fixHeader = true;
+			break;
+
+		case 'i':
+			options.stateFileName = arg;
+			break;
+
+		case 'm':
+			if (std::optional<uint64_t> value = parseWholeNumber(arg); !value) {
+				fatal("Invalid argument for option '--mbc-type'");
+			} else if (*value > 0xFF) {
+				fatal("Argument for option '--mbc-type' must be between 0 and 0xFF");
+			} else {
+				options.mbcType = *value;
+			}
+			break;
+
+		case 'p':
+			if (!profile_Parse(arg)) {
+				fatal("Invalid argument for option '--profile'");
+			}
+			break;
+
+		case 't':
+			if (options.title) {
+				warnx("Overriding title \"%s\"", options.title->c_str());
+			}
+			options.title = arg;
+			if (uint8_t maxLen = header_MaxTitleLen(false, false);
+			    options.title->length() > maxLen) {
+				warnx("Truncating title \"%s\" to %u chars", arg, maxLen);
+				options.title->resize(maxLen);
+			}
+			break;
 		}
 		break;
 
@@ -407,6 +462,8 @@ static void verboseOutputConfig() {
 	}
 	// -n/--sym
 	printPath("Output sym file", options.symFileName);
+	// --incremental
+	printPath("Link state file", options.stateFileName);
 	fputs("Ready for linking\n", stderr);
 }
 // LCOV_EXCL_STOP
@@ -420,6 +477,8 @@ int main(int argc, char *argv[]) {
 		usage.printAndExit("No input file specified (pass \"-\" to read from standard input)");
 	}
 
+	profile_ReportAtExit("rgblink");
+
 	// Patch the size array depending on command-line options
 	if (!options.is32kMode) {
 		sectionTypeInfo[SECTTYPE_ROM0].size = 0x4000;
@@ -437,11 +496,14 @@ int main(int argc, char *argv[]) {
 	size_t nbFiles = localOptions.inputFileNames.size();
 	obj_Setup(nbFiles);
 	for (size_t i = 0; i < nbFiles; ++i) {
-		obj_ReadFile(localOptions.inputFileNames[i], nbFiles - i - 1);
+		std::string const &fileName = localOptions.inputFileNames[i];
+		size_t fileID = nbFiles - i - 1;
+		incr_AddObject(fileName, fileID, obj_ReadFile(fileName, fileID));
 	}
 
 	// apply the linker script's modifications,
 	if (localOptions.linkerScriptName) {
+		ProfileScope scope(linkerScriptPhase);
 		verbosePrint(VERB_NOTICE, "Reading linker script...\n");
 
 		if (yy::parser parser; lexer_Init(*localOptions.linkerScriptName) && parser.parse() != 0) {
@@ -456,13 +518,19 @@ int main(int argc, char *argv[]) {
 	// then process them,
 	sect_DoSanityChecks();
 	requireZeroErrors();
-	assign_AssignSections();
+	sym_ResolveImports();
+	if (!incr_RestorePlacement()) {
+		assign_AssignSections();
+	}
 	patch_CheckAssertions();
 
 	// and finally output the result.
+	obj_LoadSections();
+	incr_FindDirtyBanks();
 	patch_ApplyPatches();
 	requireZeroErrors();
 	out_WriteFiles();
+	incr_SaveState();
 
 	return 0;
 }
@@ -16,14 +16,17 @@
 #include <variant>
 #include <vector>
 
+#include "hash.hpp"
 #include "helpers.hpp"
 #include "linkdefs.hpp"
 #include "platform.hpp"
+#include "profile.hpp"
 #include "util.hpp" // xfclose
 #include "verbosity.hpp"
 #include "version.hpp"
 
 #include "link/fstack.hpp"
+#include "link/main.hpp"
 #include "link/patch.hpp"
 #include "link/sdas_obj.hpp"
 #include "link/section.hpp"
@@ -33,8 +36,47 @@
 static std::deque<std::vector<Symbol>> symbolLists;
 static std::vector<std::vector<FileStackNode>> nodes;
 
+// Compact objects store LONGs as varints, and STRINGs as indexes into a table of them
+static bool isCompact;
+static std::vector<std::string> stringTable;
+
+// Compact objects also give the size of ROM sections' data and patches, which are only read once
+// patches are about to be applied
+struct DeferredPayload {
+	Section *section;
+	uint16_t size; // The section's own, since merging fragments grows the first one
+	long offset;
+};
+struct DeferredObject {
+	std::string path;
+	size_t fileID;
+	std::vector<Section *> sections; // Indexed by section ID, for patches' PC sections
+	std::vector<DeferredPayload> payloads;
+};
+static std::vector<DeferredObject> deferredObjects;
+
+// Incremental links hash every byte read from each object, deferred payloads included
+static std::vector<Hasher> hashers;
+static Hasher *hasher = nullptr; // The current object's, if it is being hashed
+
 // Helper functions for reading object files
 
+static int readByte(FILE *file) {
+	int byte = getc(file);
+	if (hasher && byte != EOF) {
+		hasher->add(static_cast<uint8_t>(byte));
+	}
+	return byte;
+}
+
+static size_t readBytes(void *data, size_t size, FILE *file) {
+	size_t nbRead = fread(data, 1, size, file);
+	if (hasher) {
+		hasher->addBytes(static_cast<uint8_t const *>(data), nbRead);
+	}
+	return nbRead;
+}
+
 // For internal use only by `tryReadLong` and `tryGetc`!
 #define tryRead(func, type, errval, vartype, var, file, ...) \
 	do { \
@@ -46,13 +88,39 @@ static std::vector<std::vector<FileStackNode>> nodes;
 		var = static_cast<vartype>(tmpVal); \
 	} while (0)
 
+// Reads an unsigned LEB128 value that fits in 32 bits from a file, or `INT64_MAX` on failure.
+static int64_t readVarint(FILE *file) {
+	uint32_t value = 0;
+
+	for (uint8_t shift = 0;; shift += 7) {
+		int byte = readByte(file);
+
+		if (byte == EOF) {
+			return INT64_MAX;
+		}
+		// The fifth byte only has 4 bits left to give, and must be the last one
+		if (shift == 28 && byte > 0x0F) {
+			errno = ERANGE;
+			return INT64_MAX;
+		}
+		value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+}
+
 // Reads an unsigned long (32-bit) value from a file, or `INT64_MAX` on failure.
 static int64_t readLong(FILE *file) {
+	if (isCompact) {
+		return readVarint(file);
+	}
+
 	uint32_t value = 0;
 
 	// Read the little-endian value byte by byte
 	for (uint8_t shift = 0; shift < sizeof(value) * CHAR_BIT; shift += 8) {
-		int byte = getc(file);
+		int byte = readByte(file);
 
 		if (byte == EOF) {
 			return INT64_MAX;
@@ -68,19 +136,42 @@ static int64_t readLong(FILE *file) {
 	tryRead(readLong, int64_t, INT64_MAX, long, var, file, __VA_ARGS__)
 
 // Helper macro to read a byte from a file to a var, or error out if it fails to.
-#define tryGetc(var, file, ...) tryRead(getc, int, EOF, uint8_t, var, file, __VA_ARGS__)
+#define tryGetc(var, file, ...) tryRead(readByte, int, EOF, uint8_t, var, file, __VA_ARGS__)
+
+// Reads a '\0'-terminated string from a file, returning false on failure.
+static bool readRawString(FILE *file, std::string &str) {
+	for (int byte; (byte = readByte(file)) != '\0';) {
+		if (byte == EOF) {
+			return false;
+		}
+		str.push_back(byte);
+	}
+	return true;
+}
+
+// Reads a string, or a compact object's string index, from a file, returning false on failure.
+static bool readString(FILE *file, std::string &str) {
+	if (!isCompact) {
+		return readRawString(file, str);
+	}
 
-// Helper macro to read a '\0'-terminated string from a file, or error out if it fails to.
+	int64_t stringID = readVarint(file);
+	if (stringID == INT64_MAX) {
+		return false;
+	} else if (static_cast<uint64_t>(stringID) >= stringTable.size()) {
+		errno = ERANGE;
+		return false;
+	}
+	str.append(stringTable[stringID]);
+	return true;
+}
+
+// Helper macro to read a string from a file to a var, or error out if it fails to.
 #define tryReadString(var, file, ...) \
 	do { \
 		FILE *tmpFile = file; \
-		std::string &tmpVal = var; \
-		for (int tmpByte; (tmpByte = getc(tmpFile)) != '\0';) { \
-			if (tmpByte == EOF) { \
-				fatal(__VA_ARGS__, feof(tmpFile) ? "Unexpected end of file" : strerror(errno)); \
-			} else { \
-				tmpVal.push_back(tmpByte); \
-			} \
+		if (!readString(tmpFile, var)) { \
+			fatal(__VA_ARGS__, feof(tmpFile) ? "Unexpected end of file" : strerror(errno)); \
 		} \
 	} while (0)
 
@@ -298,7 +389,7 @@ static void readPatch(
 	);
 
 	patch.rpnExpression.resize(rpnSize);
-	if (fread(patch.rpnExpression.data(), 1, rpnSize, file) != rpnSize) {
+	if (readBytes(patch.rpnExpression.data(), rpnSize, file) != rpnSize) {
 		fatal(
 		    "%s: Cannot read \"%s\"'s patch #%" PRIu32 "'s RPN expression: %s",
 		    fileName,
@@ -384,32 +475,60 @@ static void readSection(
 		tmp = UINT16_MAX;
 	}
 	section.alignOfs = tmp;
+}
 
-	if (sectTypeHasData(section.type)) {
-		if (section.size) {
-			section.data.resize(section.size);
-			if (fread(section.data.data(), 1, section.size, file) != section.size) {
-				fatal(
-				    "%s: Cannot read \"%s\"'s data: %s",
-				    fileName,
-				    section.name.c_str(),
-				    feof(file) ? "Unexpected end of file" : strerror(errno)
-				);
-			}
+// Reads a ROM section's data and patches from a file.
+static void readSectionPayload(
+    FILE *file,
+    Section &section,
+    uint16_t size,
+    char const *fileName,
+    std::vector<FileStackNode> const &fileNodes
+) {
+	if (size) {
+		section.data.resize(size);
+		if (readBytes(section.data.data(), size, file) != size) {
+			fatal(
+			    "%s: Cannot read \"%s\"'s data: %s",
+			    fileName,
+			    section.name.c_str(),
+			    feof(file) ? "Unexpected end of file" : strerror(errno)
+			);
 		}
+	}
 
-		uint32_t nbPatches;
-		tryReadLong(
-		    nbPatches,
-		    file,
-		    "%s: Cannot read \"%s\"'s number of patches: %s",
-		    fileName,
-		    section.name.c_str()
-		);
+	uint32_t nbPatches;
+	tryReadLong(
+	    nbPatches,
+	    file,
+	    "%s: Cannot read \"%s\"'s number of patches: %s",
+	    fileName,
+	    section.name.c_str()
+	);
 
-		section.patches.resize(nbPatches);
-		for (uint32_t i = 0; i < nbPatches; ++i) {
-			readPatch(file, section.patches[i], fileName, section.name, i, fileNodes);
+	section.patches.resize(nbPatches);
+	for (uint32_t i = 0; i < nbPatches; ++i) {
+		readPatch(file, section.patches[i], fileName, section.name, i, fileNodes);
+	}
+}
+
+// Gives a section's patches' PC section pointers to their sections.
+static void linkPatchSections(
+    Section &section, std::vector<Section *> const &fileSections, char const *fileName
+) {
+	for (size_t i = 0; i < section.patches.size(); ++i) {
+		if (Patch &patch = section.patches[i]; patch.pcSectionID == UINT32_MAX) {
+			patch.pcSection = nullptr;
+		} else if (patch.pcSectionID >= fileSections.size()) {
+			fatal(
+			    "%s: \"%s\"'s patch #%zu has invalid section ID #%" PRIu32,
+			    fileName,
+			    section.name.c_str(),
+			    i,
+			    patch.pcSectionID
+			);
+		} else {
+			patch.pcSection = fileSections[patch.pcSectionID];
 		}
 	}
 }
@@ -429,7 +548,13 @@ static void readAssertion(
 	tryReadString(assert.message, file, "%s: Cannot read assertion's message: %s", fileName);
 }
 
-void obj_ReadFile(std::string const &filePath, size_t fileID) {
+static ProfilePhase readingPhase("reading objects");
+static ProfileCounter nbObjects("objects");
+
+std::vector<Symbol> const &obj_ReadFile(std::string const &filePath, size_t fileID) {
+	ProfileScope scope(readingPhase);
+	++nbObjects;
+
 	FILE *file;
 	char const *fileName = filePath.c_str();
 	if (filePath != "-") {
@@ -443,6 +568,7 @@ void obj_ReadFile(std::string const &filePath, size_t fileID) {
 		fatal("Failed to open file \"%s\": %s", fileName, strerror(errno));
 	}
 	Defer closeFile{[&] { xfclose(file); }};
+	hasher = options.stateFileName ? &hashers[fileID] : nullptr;
 
 	// First, check if the object is a RGBDS object, a SDCC one, or neither.
 	// A single `ungetc` is guaranteed to work.
@@ -466,14 +592,14 @@ void obj_ReadFile(std::string const &filePath, size_t fileID) {
 
 		std::vector<Symbol> &fileSymbols = symbolLists.emplace_front();
 
-		sdobj_ReadFile(nodes[fileID].back(), file, fileSymbols);
-		return;
+		sdobj_ReadFile(nodes[fileID].back(), file, fileSymbols, hasher);
+		return fileSymbols;
 	}
 
 	case 'R':
 		// Check the magic byte signature for a RGB object file.
 		if (char magic[literal_strlen(RGBDS_OBJECT_VERSION_STRING)];
-		    fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+		    readBytes(magic, sizeof(magic), file) == sizeof(magic)
 		    && !memcmp(magic, RGBDS_OBJECT_VERSION_STRING, sizeof(magic))) {
 			break;
 		}
@@ -485,21 +611,42 @@ void obj_ReadFile(std::string const &filePath, size_t fileID) {
 
 	verbosePrint(VERB_NOTICE, "Reading object file %s\n", fileName);
 
+	// The revision is a fixed-size LONG even in compact objects
+	isCompact = false;
 	uint32_t revNum;
 	tryReadLong(revNum, file, "%s: Cannot read revision number: %s", fileName);
-	if (revNum != RGBDS_OBJECT_REV) {
+	if (revNum != RGBDS_OBJECT_REV && revNum != RGBDS_OBJECT_REV_COMPACT) {
 		fatal(
 		    "%s: Unsupported object file for rgblink %s; try rebuilding \"%s\"%s"
-		    " (expected revision %d, got %d)",
+		    " (expected revision %d or %d, got %d)",
 		    fileName,
 		    get_package_version_string(),
 		    fileName,
-		    revNum > RGBDS_OBJECT_REV ? " or updating rgblink" : "",
+		    revNum > RGBDS_OBJECT_REV_COMPACT ? " or updating rgblink" : "",
 		    RGBDS_OBJECT_REV,
+		    RGBDS_OBJECT_REV_COMPACT,
 		    revNum
 		);
 	}
 
+	isCompact = revNum == RGBDS_OBJECT_REV_COMPACT;
+	stringTable.clear();
+	if (isCompact) {
+		uint32_t nbStrings;
+		tryReadLong(nbStrings, file, "%s: Cannot read number of strings: %s", fileName);
+		stringTable.resize(nbStrings);
+		for (uint32_t i = 0; i < nbStrings; ++i) {
+			if (!readRawString(file, stringTable[i])) {
+				fatal(
+				    "%s: Cannot read string #%" PRIu32 ": %s",
+				    fileName,
+				    i,
+				    feof(file) ? "Unexpected end of file" : strerror(errno)
+				);
+			}
+		}
+	}
+
 	uint32_t nbSymbols;
 	tryReadLong(nbSymbols, file, "%s: Cannot read number of symbols: %s", fileName);
 
@@ -538,14 +685,45 @@ void obj_ReadFile(std::string const &filePath, size_t fileID) {
 
 	// This file's sections, stored in a table to link symbols to them
 	std::vector<std::unique_ptr<Section>> fileSections(nbSections);
+	// Payloads can only be skipped if the file can be read again later
+	bool canDefer = isCompact && filePath != "-" && ftell(file) != -1;
+	DeferredObject deferred{.path = filePath, .fileID = fileID, .sections = {}, .payloads = {}};
 
 	verbosePrint(VERB_INFO, "Reading %" PRIu32 " sections...\n", nbSections);
 	for (uint32_t i = 0; i < nbSections; ++i) {
 		fileSections[i] = std::make_unique<Section>();
-		fileSections[i]->nextPiece = nullptr;
-		readSection(file, *fileSections[i], fileName, nodes[fileID]);
-		fileSections[i]->fileSymbols = &fileSymbols;
-		fileSections[i]->symbols.reserve(nbSymPerSect[i]);
+		Section &section = *fileSections[i];
+		section.nextPiece = nullptr;
+		readSection(file, section, fileName, nodes[fileID]);
+		section.fileSymbols = &fileSymbols;
+		section.symbols.reserve(nbSymPerSect[i]);
+		deferred.sections.push_back(&section);
+
+		if (!sectTypeHasData(section.type)) {
+			continue;
+		}
+		uint32_t payloadSize = 0;
+		if (isCompact) {
+			tryReadLong(
+			    payloadSize,
+			    file,
+			    "%s: Cannot read \"%s\"'s payload size: %s",
+			    fileName,
+			    section.name.c_str()
+			);
+		}
+		// Empty sections have no data to load later, so their patches are read right away
+		if (canDefer && section.size != 0) {
+			long offset = ftell(file);
+			if (offset != -1 && fseek(file, payloadSize, SEEK_CUR) == 0) {
+				deferred.payloads.push_back(
+				    {.section = &section, .size = section.size, .offset = offset}
+				);
+				section.isDataDeferred = true;
+				continue;
+			}
+		}
+		readSectionPayload(file, section, section.size, fileName, nodes[fileID]);
 	}
 
 	uint32_t nbAsserts;
@@ -573,26 +751,14 @@ void obj_ReadFile(std::string const &filePath, size_t fileID) {
 	}
 
 	// Give patches' PC section pointers to their sections
-	for (std::unique_ptr<Section> const &sect : fileSections) {
-		if (!sectTypeHasData(sect->type)) {
-			continue;
-		}
-		for (size_t i = 0; i < sect->patches.size(); ++i) {
-			if (Patch &patch = sect->patches[i]; patch.pcSectionID == UINT32_MAX) {
-				patch.pcSection = nullptr;
-			} else if (patch.pcSectionID >= fileSections.size()) {
-				fatal(
-				    "%s: \"%s\"'s patch #%zu has invalid section ID #%" PRIu32,
-				    fileName,
-				    sect->name.c_str(),
-				    i,
-				    patch.pcSectionID
-				);
-			} else {
-				patch.pcSection = fileSections[patch.pcSectionID].get();
-			}
+	for (Section *section : deferred.sections) {
+		if (sectTypeHasData(section->type)) {
+			linkPatchSections(*section, deferred.sections, fileName);
 		}
 	}
+	if (!deferred.payloads.empty()) {
+		deferredObjects.push_back(std::move(deferred));
+	}
 
 	// Give symbols' section pointers to their sections
 	for (Symbol &sym : fileSymbols) {
@@ -612,8 +778,55 @@ void obj_ReadFile(std::string const &filePath, size_t fileID) {
 	for (Symbol &sym : fileSymbols) {
 		sym.fixSectionOffset();
 	}
+
+	return fileSymbols;
+}
+
+static ProfilePhase loadingPhase("loading sections");
+
+void obj_LoadSections() {
+	ProfileScope scope(loadingPhase);
+
+	// Only compact objects have deferred payloads
+	isCompact = true;
+	for (DeferredObject const &object : deferredObjects) {
+		char const *fileName = object.path.c_str();
+		FILE *file = fopen(fileName, "rb");
+		if (!file) {
+			fatal("Failed to open file \"%s\": %s", fileName, strerror(errno));
+		}
+		Defer closeFile{[&] { xfclose(file); }};
+		hasher = options.stateFileName ? &hashers[object.fileID] : nullptr;
+
+		verbosePrint(
+		    VERB_INFO, "Loading %zu sections from %s...\n", object.payloads.size(), fileName
+		);
+		for (auto [section, size, offset] : object.payloads) {
+			if (fseek(file, offset, SEEK_SET) != 0) {
+				fatal(
+				    "%s: Cannot seek to \"%s\"'s data: %s",
+				    fileName,
+				    section->name.c_str(),
+				    strerror(errno)
+				);
+			}
+			readSectionPayload(file, *section, size, fileName, nodes[object.fileID]);
+			// Fragments' patches could not be adjusted when they were merged
+			for (Patch &patch : section->patches) {
+				patch.pcOffset += section->offset;
+			}
+			linkPatchSections(*section, object.sections, fileName);
+			section->isDataDeferred = false;
+		}
+	}
+	deferredObjects.clear();
+}
+
+uint64_t obj_GetHash(size_t fileID) {
+	return hashers[fileID].value();
 }
 
 void obj_Setup(size_t nbFiles) {
 	nodes.resize(nbFiles);
+	hashers.resize(nbFiles);
 }
@@ -20,8 +20,11 @@
 #include "helpers.hpp"
 #include "linkdefs.hpp"
 #include "platform.hpp"
+#include "profile.hpp"
+#include "romheader.hpp"
 #include "util.hpp"
 
+#include "link/incremental.hpp"
 #include "link/main.hpp"
 #include "link/section.hpp"
 #include "link/symbol.hpp"
@@ -168,23 +171,33 @@ static uint8_t getNextFillByte() {
 	return options.padValue;
 }
 
-static void
-    writeBank(std::deque<Section const *> *bankSections, uint16_t baseOffset, uint16_t size) {
-	uint16_t offset = 0;
+// Lays out a bank in memory, so that it can be written all at once
+static void renderBank(
+    std::vector<uint8_t> &bank,
+    std::deque<Section const *> const *bankSections,
+    uint16_t baseOffset,
+    uint16_t size
+) {
+	bank.clear();
+	bank.reserve(size);
 
 	if (bankSections) {
 		for (Section const *section : *bankSections) {
 			assume(section->offset == 0);
 			// Output padding up to the next SECTION
-			while (offset + baseOffset < section->org) {
-				putc(getNextFillByte(), outputFile);
-				++offset;
+			while (bank.size() + baseOffset < section->org) {
+				bank.push_back(getNextFillByte());
 			}
 
-			// Output the section itself
-			assume(section->size == section->data.size());
-			fwrite(section->data.data(), 1, section->size, outputFile);
-			offset += section->size;
+			// Output the section itself, gathering its fragments in place
+			size_t start = bank.size();
+			bank.resize(start + section->size);
+			for (Section const &piece : section->pieces()) {
+				if (!piece.data.empty()) {
+					assume(piece.offset + piece.data.size() <= section->size);
+					memcpy(&bank[start + piece.offset], piece.data.data(), piece.data.size());
+				}
+			}
 
 			if (!overlayFile) {
 				continue;
@@ -197,18 +210,43 @@ static void
 	}
 
 	if (!options.disablePadding) {
-		while (offset < size) {
-			putc(getNextFillByte(), outputFile);
-			++offset;
+		while (bank.size() < size) {
+			bank.push_back(getNextFillByte());
 		}
 	}
 }
 
+static void warnOverwrite(char const *fieldName) {
+	warning("Overwrote a non-zero byte in the %s", fieldName);
+}
+
+// Writes every requested header field that does not depend on the rest of the ROM
+static void fixHeaderFields(std::vector<uint8_t> &rom0) {
+	if (rom0.size() < HEADER_END) {
+		fatal(
+		    "Cannot fix the header of a ROM smaller than $%04x bytes (got only $%04zx)",
+		    HEADER_END,
+		    rom0.size()
+		);
+	}
+
+	HeaderWriter header(rom0.data(), warnOverwrite);
+	if (options.fixHeader) {
+		header.writeLogo(nintendoLogo, "Nintendo logo");
+	}
+	if (options.title) {
+		header.writeTitle(*options.title, options.title->length());
+	}
+	if (options.mbcType) {
+		header.writeCartridgeType(*options.mbcType);
+	}
+}
+
 static void writeROM() {
 	if (options.outputFileName) {
 		char const *outputFileName = options.outputFileName->c_str();
 		if (*options.outputFileName != "-") {
-			outputFile = fopen(outputFileName, "wb");
+			outputFile = fopen(outputFileName, incr_IsReusingOutput() ? "r+b" : "wb");
 		} else {
 			outputFileName = "<stdout>";
 			(void)setmode(STDOUT_FILENO, O_BINARY);
@@ -249,20 +287,115 @@ static void writeROM() {
 		coverOverlayBanks(nbOverlayBanks);
 	}
 
-	if (outputFile) {
-		writeBank(
+	if (!outputFile) {
+		return;
+	}
+
+	// When updating a previous link's output in place, clean banks are neither rendered nor written
+	bool reusing = incr_IsReusingOutput();
+	bool fixingHeader = options.fixHeader || options.title || options.mbcType;
+	bool rom0Dirty = incr_IsBankDirty(SECTTYPE_ROM0, 0);
+	if (fixingHeader && !rom0Dirty) {
+		assume(reusing); // Nothing changed, since the header's checksums depend on every bank
+		return;
+	}
+
+	std::vector<uint8_t> rom0;
+	if (rom0Dirty) {
+		renderBank(
+		    rom0,
 		    !sections[SECTTYPE_ROM0].empty() ? &sections[SECTTYPE_ROM0][0].sections : nullptr,
 		    sectionTypeInfo[SECTTYPE_ROM0].startAddr,
 		    sectionTypeInfo[SECTTYPE_ROM0].size
 		);
+	}
+
+	if (fixingHeader) {
+		fixHeaderFields(rom0);
+	}
+	// The header is only complete once every bank has been summed, so ROM0 is written last, by
+	// seeking back over a placeholder if possible, or by holding the other banks back otherwise
+	bool seekable = (fixingHeader || reusing) && fseek(outputFile, 0, SEEK_CUR) == 0;
+	if (rom0Dirty && (!fixingHeader || seekable)) {
+		fwrite(rom0.data(), 1, rom0.size(), outputFile);
+	}
 
-		for (uint32_t i = 0; i < sections[SECTTYPE_ROMX].size(); ++i) {
-			writeBank(
-			    &sections[SECTTYPE_ROMX][i].sections,
-			    sectionTypeInfo[SECTTYPE_ROMX].startAddr,
-			    sectionTypeInfo[SECTTYPE_ROMX].size
-			);
+	std::vector<uint8_t> bank;
+	std::vector<uint8_t> heldBanks;
+	uint16_t romxSum = 0;
+	auto emitBank = [&](uint32_t bankID) {
+		if (fixingHeader) {
+			uint16_t sum = header_SumBytes(bank.data(), bank.size());
+			romxSum += sum;
+			incr_SetBankSum(bankID, sum);
+			if (!seekable) {
+				heldBanks.insert(heldBanks.end(), RANGE(bank));
+				return;
+			}
 		}
+		if (long ofs = sectionTypeInfo[SECTTYPE_ROM0].size + bankID * BANK_SIZE;
+		    reusing && fseek(outputFile, ofs, SEEK_SET) != 0) {
+			fatal("Failed to seek to output bank %" PRIu32 ": %s", bankID + 1, strerror(errno));
+		}
+		fwrite(bank.data(), 1, bank.size(), outputFile);
+	};
+	// Clean banks still count towards the global checksum
+	auto skipBank = [&](uint32_t bankID) {
+		if (fixingHeader) {
+			romxSum += incr_GetBankSum(bankID);
+		}
+	};
+
+	for (uint32_t i = 0; i < sections[SECTTYPE_ROMX].size(); ++i) {
+		if (!incr_IsBankDirty(SECTTYPE_ROMX, i)) {
+			skipBank(i);
+			continue;
+		}
+		renderBank(
+		    bank,
+		    &sections[SECTTYPE_ROMX][i].sections,
+		    sectionTypeInfo[SECTTYPE_ROMX].startAddr,
+		    sectionTypeInfo[SECTTYPE_ROMX].size
+		);
+		emitBank(i);
+	}
+
+	if (!fixingHeader) {
+		return;
+	}
+
+	if (options.fixHeader) {
+		HeaderWriter header(rom0.data(), warnOverwrite);
+
+		// Like `rgbfix -p`, pad to a size that can be flashed, and record it in the header
+		if (!options.disablePadding) {
+			uint32_t nbRom0Banks = sectionTypeInfo[SECTTYPE_ROM0].size / BANK_SIZE;
+			uint32_t nbBanks = nbRom0Banks + sections[SECTTYPE_ROMX].size();
+			uint32_t nbPaddedBanks = header_PaddedNbBanks(nbBanks);
+
+			for (; nbBanks < nbPaddedBanks; ++nbBanks) {
+				if (reusing) {
+					skipBank(nbBanks - nbRom0Banks);
+					continue;
+				}
+				renderBank(bank, nullptr, 0, BANK_SIZE);
+				emitBank(nbBanks - nbRom0Banks);
+			}
+			header.writeByte(HEADER_ROM_SIZE, header_RomSizeCode(nbBanks), "ROM size");
+		}
+
+		header.writeChecksum(false);
+		header.writeGlobalChecksum(rom0.size(), romxSum, false);
+	}
+
+	if (seekable) {
+		if (fseek(outputFile, 0, SEEK_SET) != 0) {
+			fatal("Failed to seek back to the output's header: %s", strerror(errno));
+		}
+		fwrite(rom0.data(), 1, rom0.size(), outputFile);
+	} else {
+		fwrite(rom0.data(), 1, rom0.size(), outputFile);
+		fwrite(heldBanks.data(), 1, heldBanks.size(), outputFile);
 	}
 }
 
@@ -623,7 +756,10 @@ static void writeMap() {
 	}
 }
 
+static ProfilePhase outputPhase("output");
+
 void out_WriteFiles() {
+	ProfileScope scope(outputPhase);
 	writeROM();
 	writeSym();
 	writeMap();
@@ -13,8 +13,10 @@
 #include "helpers.hpp" // assume
 #include "linkdefs.hpp"
 #include "opmath.hpp"
+#include "profile.hpp"
 #include "verbosity.hpp"
 
+#include "link/incremental.hpp"
 #include "link/section.hpp"
 #include "link/symbol.hpp"
 #include "link/warning.hpp"
@@ -87,19 +89,26 @@ static Symbol const *getSymbol(std::vector<Symbol> const &symbolList, uint32_t i
 	assume(index < symbolList.size()); // This needs to be checked before calling
 	Symbol const &symbol = symbolList[index];
 
-	// If the symbol is defined elsewhere...
+	// If the symbol is defined elsewhere... (resolved by `sym_ResolveImports`)
 	if (symbol.type == SYMTYPE_IMPORT) {
-		return sym_GetSymbol(symbol.name);
+		return symbol.definition;
 	}
 
 	return &symbol;
 }
 
+static ProfilePhase assertionsPhase("assertions");
+static ProfilePhase patchingPhase("patching");
+static ProfileCounter nbPatches("patches");
+static ProfileCounter nbRpnBytes("RPN bytes evaluated");
+
 // Compute a patch's value from its RPN string.
 static int32_t computeRPNExpr(Patch const &patch, std::vector<Symbol> const &fileSymbols) {
 	uint8_t const *expression = patch.rpnExpression.data();
 	int32_t size = static_cast<int32_t>(patch.rpnExpression.size());
 
+	nbRpnBytes += size;
+
 	rpnStack.clear();
 
 	while (size > 0) {
@@ -491,6 +500,7 @@ Assertion &patch_AddAssertion() {
 }
 
 void patch_CheckAssertions() {
+	ProfileScope scope(assertionsPhase);
 	verbosePrint(VERB_NOTICE, "Checking assertions...\n");
 
 	for (Assertion &assert : assertions) {
@@ -557,12 +567,13 @@ static void checkPatchSize(Patch const &patch, int32_t v, uint8_t n) {
 	}
 }
 
-// Applies all of a section's patches to a data section
-static void applyFilePatches(Section &section, Section &dataSection) {
+// Applies all of a section "piece"'s patches to its own data
+static void applyFilePatches(Section &section) {
 	verbosePrint(VERB_INFO, "Patching section \"%s\"...\n", section.name.c_str());
 	for (Patch &patch : section.patches) {
+		++nbPatches;
 		int32_t value = computeRPNExpr(patch, *section.fileSymbols);
-		uint32_t offset = patch.offset + section.offset;
+		uint32_t offset = patch.offset;
 
 		uint8_t typeSizes[PATCHTYPE_INVALID] = {
 		    1, // PATCHTYPE_BYTE
@@ -572,18 +583,18 @@ static void applyFilePatches(Section &section, Section &dataSection) {
 		};
 		uint8_t typeSize = typeSizes[patch.type];
 
-		if (dataSection.data.size() < offset + typeSize) {
+		if (section.data.size() < offset + typeSize) {
 			rpnErrorAt(
 			    patch,
 			    "Patch would write %zu bytes past the end of section \"%s\" (%zu bytes long)",
-			    offset + typeSize - dataSection.data.size(),
-			    dataSection.name.c_str(),
-			    dataSection.data.size()
+			    offset + typeSize - section.data.size(),
+			    section.name.c_str(),
+			    section.data.size()
 			);
 		} else if (patch.type == PATCHTYPE_JR) {
 			if (!patch.pcSection) {
 				rpnErrorAt(patch, "PC has no value outside of a section");
-				dataSection.data[offset] = 0;
+				section.data[offset] = 0;
 			} else {
 				// A `jr` is *encoded* in ROM as a 1-byte (8-bit) offset, so here `typeSize == 8`,
 				// but the object's *value* size is a 16-bit absolute address, so we pass 16 here.
@@ -603,7 +614,7 @@ static void applyFilePatches(Section &section, Section &dataSection) {
 					    jumpOffset
 					);
 				}
-				dataSection.data[offset] = jumpOffset & 0xFF;
+				section.data[offset] = jumpOffset & 0xFF;
 			}
 		} else {
 			// Patch a certain number of bytes
@@ -611,7 +622,7 @@ static void applyFilePatches(Section &section, Section &dataSection) {
 				checkPatchSize(patch, value, typeSize * 8);
 			}
 			for (uint8_t i = 0; i < typeSize; ++i) {
-				dataSection.data[offset + i] = value & 0xFF;
+				section.data[offset + i] = value & 0xFF;
 				value >>= 8;
 			}
 		}
@@ -623,12 +634,17 @@ static void applyPatches(Section &section) {
 	if (!sectTypeHasData(section.type)) {
 		return;
 	}
+	// Clean banks of an incremental link are already patched in the output
+	if (!incr_IsBankDirty(section.type, section.bank - sectionTypeInfo[section.type].firstBank)) {
+		return;
+	}
 
 	for (Section &piece : section.pieces()) {
-		applyFilePatches(piece, section);
+		applyFilePatches(piece);
 	}
 }
 
 void patch_ApplyPatches() {
+	ProfileScope scope(patchingPhase);
 	sect_ForEach(applyPatches);
 }
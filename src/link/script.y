@@ -6,7 +6,7 @@
 
 %code requires {
 	#include <stdint.h>
-	#include <string>
+	#include <string_view>
 
 	#include "linkdefs.hpp"
 }
@@ -35,7 +35,7 @@
 %token OPTIONAL "OPTIONAL"
 
 // Literals
-%token <std::string> string;
+%token <std::string_view> string;
 %token <uint32_t> number;
 %token <SectionType> sect_type;
 
@@ -53,7 +53,7 @@ lines:
 line:
 	INCLUDE string newline {
 		// This does *not* increment the line number until the included content has finished parsing!
-		lexer_IncludeFile(std::move($2));
+		lexer_IncludeFile($2);
 	}
 	| directive newline {
 		lexer_IncLineNo();
@@ -2,20 +2,24 @@
 
 #include "link/sdas_obj.hpp"
 
+#include <errno.h>
 #include <inttypes.h>
 #include <memory>
 #include <optional>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
 
-#include "helpers.hpp" // assume, literal_strlen
+#include "hash.hpp"
+#include "helpers.hpp" // assume, PRI_SV
 #include "linkdefs.hpp"
 #include "platform.hpp"
-#include "util.hpp" // parseWholeNumber
+#include "util.hpp" // isDigit, parseDigit, Uppercase
 
 #include "link/fstack.hpp"
 #include "link/section.hpp"
@@ -27,81 +31,108 @@ struct Location {
 	uint32_t lineNo;
 };
 
-static void consumeLF(Location const &where, FILE *file) {
-	if (getc(file) != '\n') {
-		fatalAt(where, "Bad line ending (CR without LF)");
-	}
+// Whitespace according to the C and POSIX locales
+static bool isDelim(char c) {
+	return c == ' ' || c == '\f' || c == '\n' || c == '\r' || c == '\t' || c == '\v';
 }
 
-static char const *delim = " \f\n\r\t\v"; // Whitespace according to the C and POSIX locales
-
-static int nextLine(std::vector<char> &lineBuf, Location &where, FILE *file) {
-	int firstChar;
+// Splits the next non-empty, non-comment line off of `contents`.
+// Returns its first character (the line type) and sets `line` to the rest of it, or returns EOF.
+static int nextLine(std::string_view &contents, std::string_view &line, Location &where) {
 	for (;;) {
 		++where.lineNo;
-		firstChar = getc(file);
-		lineBuf.clear();
-
-		switch (firstChar) {
-		case EOF:
+		if (contents.empty()) {
 			return EOF;
-		case ';':
-			// Discard comment line
-			// TODO: if `;!FILE [...]` on the first line (`where.lineNo`), return it
-			do {
-				firstChar = getc(file);
-			} while (firstChar != EOF && firstChar != '\r' && firstChar != '\n');
-			[[fallthrough]];
-		case '\r':
-			if (firstChar == '\r') {
-				consumeLF(where, file);
+		}
+
+		char const *start = contents.data();
+		char const *newline = static_cast<char const *>(memchr(start, '\n', contents.size()));
+		size_t len = newline ? newline - start : contents.size();
+		contents.remove_prefix(newline ? len + 1 : len);
+
+		// A CR may only appear as part of a CRLF line ending
+		if (char const *cr = static_cast<char const *>(memchr(start, '\r', len)); cr) {
+			if (cr != &start[len - 1] || !newline) {
+				fatalAt(where, "Bad line ending (CR without LF)");
 			}
-			[[fallthrough]];
-		case '\n':
+			--len;
+		}
+
+		// Discard empty and comment lines
+		// TODO: if `;!FILE [...]` on the first line (`where.lineNo`), return it
+		if (len == 0 || start[0] == ';') {
 			continue;
 		}
-		break;
+		line = std::string_view(&start[1], len - 1);
+		// Lines end at any NUL byte, as if they were C strings
+		line = line.substr(0, line.find('\0'));
+		return static_cast<uint8_t>(start[0]);
 	}
+}
 
-	for (;;) {
-		int c = getc(file);
-
-		switch (c) {
-		case '\r':
-			consumeLF(where, file);
-			[[fallthrough]];
-		case '\n':
-		case EOF:
-			lineBuf.push_back('\0'); // Terminate the string (space was ensured above)
-			return firstChar;
+// Splits the next whitespace-delimited token off of `line`; returns an empty view if none is left
+static std::string_view nextToken(std::string_view &line) {
+	size_t start = 0;
+	while (start < line.size() && isDelim(line[start])) {
+		++start;
+	}
+	size_t end = start;
+	while (end < line.size() && !isDelim(line[end])) {
+		++end;
+	}
+	std::string_view token = line.substr(start, end - start);
+	line.remove_prefix(end);
+	return token;
+}
+
+// Parses a whole token, saturating on overflow like `parseWholeNumber`
+template<uint32_t Base>
+    requires ValidBaseV<Base>
+static std::optional<uint64_t> parseToken(std::string_view token) {
+	if (token.empty()) {
+		return std::nullopt;
+	}
+
+	uint64_t result = 0;
+	bool overflowed = false;
+	for (char c : token) {
+		if (!isDigit<Base>(c)) {
+			return std::nullopt;
 		}
-		lineBuf.push_back(c);
+		uint8_t digit = parseDigit<Base>(c);
+		if (result > (UINT64_MAX - digit) / Base) {
+			overflowed = true;
+		}
+		result = result * Base + digit;
 	}
+	return overflowed ? UINT64_MAX : result;
 }
 
-static uint64_t readNumber(Location const &where, char const *str, NumberBase base) {
-	std::optional<uint64_t> res = parseWholeNumber(str, base);
+static uint64_t readNumber(Location const &where, std::string_view token, NumberBase base) {
+	std::optional<uint64_t> res = base == BASE_16  ? parseToken<16>(token)
+	                              : base == BASE_10 ? parseToken<10>(token)
+	                                                : parseToken<8>(token);
 
 	if (!res) {
-		fatalAt(where, "Expected number, got \"%s\"", str);
+		fatalAt(where, "Expected number, got \"%" PRI_SV "\"", PRI_SV_ARG(token));
 	}
 	return *res;
 }
 
-static uint32_t readInt(Location const &where, char const *str, NumberBase base) {
-	uint64_t num = readNumber(where, str, base);
+static uint32_t readInt(Location const &where, std::string_view token, NumberBase base) {
+	uint64_t num = readNumber(where, token, base);
 
 	if (num > UINT32_MAX) {
-		fatalAt(where, "\"%s\" is not an int", str);
+		fatalAt(where, "\"%" PRI_SV "\" is not an int", PRI_SV_ARG(token));
 	}
 	return num;
 }
 
-static uint8_t readByte(Location const &where, char const *str, NumberBase base) {
-	uint64_t num = readNumber(where, str, base);
+static uint8_t readByte(Location const &where, std::string_view token, NumberBase base) {
+	uint64_t num = readNumber(where, token, base);
 
 	if (num > UINT8_MAX) {
-		fatalAt(where, "\"%s\" is not a byte", str);
+		fatalAt(where, "\"%" PRI_SV "\" is not a byte", PRI_SV_ARG(token));
 	}
 	return num;
 }
@@ -131,49 +162,67 @@ enum RelocFlags {
 	                  | 1 << RELOC_WHICHBYTE | 1 << RELOC_EXPR24 | 1 << RELOC_BANKBYTE,
 };
 
-void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &fileSymbols) {
+void sdobj_ReadFile(
+    FileStackNode const &src, FILE *file, std::vector<Symbol> &fileSymbols, Hasher *hasher
+) {
 	Location where{.src = &src, .lineNo = 0};
 
-	std::vector<char> line;
-	line.reserve(256);
-	char const *token;
+	// Read the whole file at once; lines and tokens are then views of it
+	std::vector<char> buffer(0x10000);
+	size_t size = 0;
+	while (size_t nbRead = fread(&buffer[size], 1, buffer.size() - size, file)) {
+		size += nbRead;
+		if (size == buffer.size()) {
+			buffer.resize(buffer.size() * 2);
+		}
+	}
+	if (ferror(file)) {
+		fatal("Failed to read \"%s\": %s", src.name().c_str(), strerror(errno)); // LCOV_EXCL_LINE
+	}
+	if (hasher) {
+		hasher->addBytes(reinterpret_cast<uint8_t const *>(buffer.data()), size);
+	}
+	std::string_view contents(buffer.data(), size);
+
+	std::string_view line;
+	std::string_view token;
 
 #define expectEol(lineType) \
 	do { \
-		token = strtok(nullptr, delim); \
-		if (token) { \
+		token = nextToken(line); \
+		if (!token.empty()) { \
 			fatalAt(where, "'%c' line is too long", (lineType)); \
 		} \
 	} while (0)
-#define expectNext(ptr, lineType) \
+#define expectNext(lineType) \
 	do { \
-		token = strtok((ptr), delim); \
-		if (!token) { \
+		token = nextToken(line); \
+		if (token.empty()) { \
 			fatalAt(where, "'%c' line is too short", (lineType)); \
 		} \
 	} while (0)
 #define expectRelocation() \
 	do { \
-		token = strtok(nullptr, delim); \
-		if (!token) { \
+		token = nextToken(line); \
+		if (token.empty()) { \
 			fatalAt(where, "Incomplete relocation"); \
 		} \
 	} while (0)
 #define expectToken(expected, lineType) \
 	do { \
-		expectNext(nullptr, lineType); \
-		if (strcasecmp(token, (expected)) != 0) { \
+		expectNext(lineType); \
+		if (!Uppercase{}(token, (expected))) { \
 			fatalAt( \
 			    where, \
-			    "Malformed '%c' line: expected \"%s\", got \"%s\"", \
+			    "Malformed '%c' line: expected \"%s\", got \"%" PRI_SV "\"", \
 			    (lineType), \
 			    (expected), \
-			    token \
+			    PRI_SV_ARG(token) \
 			); \
 		} \
 	} while (0)
 
-	int lineType = nextLine(line, where, file);
+	int lineType = nextLine(contents, line, where);
 
 	// The first letter (thus, the line type) identifies the integer type
 	NumberBase numberBase;
@@ -197,17 +246,17 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 		);
 	}
 
-	switch (line[0]) {
+	switch (char endianness = !line.empty() ? line[0] : '\0'; endianness) {
 	case 'L':
 		break;
 	case 'H':
 		fatalAt(where, "Big-endian SDCC object files are not supported");
 	default:
-		fatalAt(where, "Unknown endianness type '%c'", line[0]);
+		fatalAt(where, "Unknown endianness type '%c'", endianness);
 	}
 
 	uint8_t addrSize;
-	switch (line[1]) {
+	switch (char addrSizeChar = line.size() > 1 ? line[1] : '\0'; addrSizeChar) {
 	case '3':
 		addrSize = 3;
 		break;
@@ -215,30 +264,34 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 		addrSize = 4;
 		break;
 	default:
-		fatalAt(where, "Unknown or unsupported address size '%c'", line[1]);
+		fatalAt(where, "Unknown or unsupported address size '%c'", addrSizeChar);
 	}
 
-	if (line[2] != '\0') {
-		warningAt(where, "Ignoring unknown characters (\"%s\") in first line", &line[2]);
+	if (line.size() > 2) {
+		warningAt(
+		    where,
+		    "Ignoring unknown characters (\"%" PRI_SV "\") in first line",
+		    PRI_SV_ARG(line.substr(2))
+		);
 	}
 
 	// Header line
 
-	lineType = nextLine(line, where, file);
+	lineType = nextLine(contents, line, where);
 	if (lineType != 'H') {
 		fatalAt(where, "Expected header line, got '%c' line", lineType);
 	}
 	// Expected format: "A areas S global symbols"
 
-	token = strtok(line.data(), delim);
-	if (!token) {
+	token = nextToken(line);
+	if (token.empty()) {
 		fatalAt(where, "Empty 'H' line");
 	}
 	uint32_t expectedNbAreas = readInt(where, token, numberBase);
 
 	expectToken("areas", 'H');
 
-	expectNext(nullptr, 'H');
+	expectNext('H');
 	uint32_t expectedNbSymbols = readInt(where, token, numberBase);
 	fileSymbols.reserve(expectedNbSymbols);
 
@@ -258,7 +311,7 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 	std::vector<uint8_t> data;
 
 	for (;;) {
-		lineType = nextLine(line, where, file);
+		lineType = nextLine(contents, line, where);
 		if (lineType == EOF) {
 			break;
 		}
@@ -277,30 +330,33 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 			curSection->src = where.src;
 			curSection->lineNo = where.lineNo;
 
-			expectNext(line.data(), 'A');
-			assume(strlen(token) != 0); // This should be impossible, tokens are non-empty
+			expectNext('A');
 			// The following is required for fragment offsets to be reliably predicted
 			for (FileSection &entry : fileSections) {
-				if (!strcmp(token, entry.section->name.c_str())) {
-					fatalAt(where, "Area \"%s\" already defined", token);
+				if (token == entry.section->name) {
+					fatalAt(where, "Area \"%" PRI_SV "\" already defined", PRI_SV_ARG(token));
 				}
 			}
-			char const *sectName = token; // We'll deal with the section's name depending on type
+			std::string_view sectName = token; // We'll deal with the name depending on type
 
 			expectToken("size", 'A');
 
-			expectNext(nullptr, 'A');
+			expectNext('A');
 
 			uint32_t tmp = readInt(where, token, numberBase);
 
 			if (tmp > UINT16_MAX) {
-				fatalAt(where, "Area \"%s\" is larger than the GB address space", sectName);
+				fatalAt(
+				    where,
+				    "Area \"%" PRI_SV "\" is larger than the GB address space",
+				    PRI_SV_ARG(sectName)
+				);
 			}
 			curSection->size = tmp;
 
 			expectToken("flags", 'A');
 
-			expectNext(nullptr, 'A');
+			expectNext('A');
 			tmp = readInt(where, token, numberBase);
 			if (tmp & (1 << AREA_PAGING)) {
 				fatalAt(where, "Paging is not supported");
@@ -319,7 +375,7 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 
 			expectToken("addr", 'A');
 
-			expectNext(nullptr, 'A');
+			expectNext('A');
 			tmp = readInt(where, token, numberBase);
 			curSection->org = tmp; // Truncation keeps the address portion only
 			curSection->bank = tmp >> 16;
@@ -372,18 +428,20 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 			symbol.src = where.src;
 			symbol.lineNo = where.lineNo;
 
-			expectNext(line.data(), 'S');
+			expectNext('S');
 			symbol.name = token;
 
-			expectNext(nullptr, 'S');
+			expectNext('S');
 
 			// Expected format: /[DR]ef[0-9A-F]+/i
-			if ((token[0] != 'D' && token[0] != 'd' && token[0] != 'R' && token[0] != 'r')
+			if (token.size() < 3
+			    || (token[0] != 'D' && token[0] != 'd' && token[0] != 'R' && token[0] != 'r')
 			    || token[1] != 'e' || token[2] != 'f') {
 				fatalAt(where, "'S' line is neither \"Def\" nor \"Ref\"");
 			}
 
-			if (int32_t value = readInt(where, &token[3], numberBase); !fileSections.empty()) {
+			if (int32_t value = readInt(where, token.substr(3), numberBase);
+			    !fileSections.empty()) {
 				// Symbols in sections are labels; their value is an offset
 				Section *section = fileSections.back().section.get();
 				if (section->isAddressFixed) {
@@ -456,7 +514,7 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 			}
 
 			data.clear();
-			for (token = strtok(line.data(), delim); token; token = strtok(nullptr, delim)) {
+			for (token = nextToken(line); !token.empty(); token = nextToken(line)) {
 				data.push_back(readByte(where, token, numberBase));
 			}
 
@@ -474,13 +532,13 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 			}
 
 			// First two bytes are ignored
-			expectNext(line.data(), 'R');
-			expectNext(nullptr, 'R');
+			expectNext('R');
+			expectNext('R');
 			uint16_t areaIdx;
 
-			expectNext(nullptr, 'R');
+			expectNext('R');
 			areaIdx = readByte(where, token, numberBase);
-			expectNext(nullptr, 'R');
+			expectNext('R');
 			areaIdx |= static_cast<uint16_t>(readByte(where, token, numberBase)) << 8;
 			if (areaIdx >= fileSections.size()) {
 				fatalAt(
@@ -540,7 +598,7 @@ void sdobj_ReadFile(FileStackNode const &src, FILE *file, std::vector<Symbol> &f
 			// This all can be "translated" to RGBDS parlance by generating the
 			// appropriate RPN expression (depending on flags), plus an addition for the
 			// bytes being patched over.
-			while ((token = strtok(nullptr, delim)) != nullptr) {
+			while (!(token = nextToken(line)).empty()) {
 				uint16_t flags = readByte(where, token, numberBase);
 
 				if ((flags & 0xF0) == 0xF0) {
@@ -2,22 +2,28 @@
 
 #include "link/section.hpp"
 
+#include <functional> // equal_to
 #include <inttypes.h>
 #include <memory>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "helpers.hpp"
 #include "itertools.hpp" // InsertionOrderedMap
 #include "linkdefs.hpp"
+#include "profile.hpp"
+#include "util.hpp" // StringHash
 
 #include "link/main.hpp"
 #include "link/warning.hpp"
 
-static InsertionOrderedMap<std::string, std::unique_ptr<Section>> sections;
+// Linker scripts look sections up by views of their own contents
+static InsertionOrderedMap<std::string, std::unique_ptr<Section>, StringHash, std::equal_to<>>
+    sections;
 
 void sect_ForEach(void (*callback)(Section &)) {
 	for (std::unique_ptr<Section> &ptr : sections) {
@@ -149,14 +155,14 @@ static void mergeSections(Section &target, std::unique_ptr<Section> &&other) {
 		// Append `other` to `target`
 		other->offset = target.size;
 		target.size += other->size;
-		// Normally we'd check that `sectTypeHasData`, but SDCC areas may be `_INVALID` here
-		if (!other->data.empty()) {
-			target.data.insert(target.data.end(), RANGE(other->data));
-			// Adjust patches' PC offsets
+		// Normally we'd check that `sectTypeHasData`, but SDCC areas may be `_INVALID` here.
+		// The data itself stays in `other`, and is only copied once, into the output ROM.
+		if (!other->data.empty() || other->isDataDeferred) {
+			// Adjust patches' PC offsets (deferred ones are adjusted once loaded)
 			for (Patch &patch : other->patches) {
 				patch.pcOffset += other->offset;
 			}
-		} else if (!target.data.empty()) {
+		} else if (target.hasData()) {
 			assume(other->size == 0);
 		}
 		break;
@@ -173,7 +179,12 @@ static void mergeSections(Section &target, std::unique_ptr<Section> &&other) {
 	target.nextPiece = std::move(other);
 }
 
+static ProfilePhase sanityChecksPhase("sanity checks");
+static ProfileCounter nbSections("sections");
+
 void sect_AddSection(std::unique_ptr<Section> &&section) {
+	++nbSections;
+
 	// Check if the section already exists; if not, add it
 	if (Section *target = sect_GetSection(section->name); target) {
 		mergeSections(*target, std::move(section));
@@ -188,7 +199,7 @@ void sect_AddSection(std::unique_ptr<Section> &&section) {
 	}
 }
 
-Section *sect_GetSection(std::string const &name) {
+Section *sect_GetSection(std::string_view name) {
 	auto index = sections.findIndex(name);
 	return index ? sections[*index].get() : nullptr;
 }
@@ -335,5 +346,6 @@ static void doSanityChecks(Section &section) {
 }
 
 void sect_DoSanityChecks() {
+	ProfileScope scope(sanityChecksPhase);
 	sect_ForEach(doSanityChecks);
 }
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <variant>
@@ -13,13 +14,18 @@
 
 #include "helpers.hpp" // assume
 #include "linkdefs.hpp"
+#include "profile.hpp"
 
 #include "link/fstack.hpp"
 #include "link/section.hpp"
 #include "link/warning.hpp"
 
-static std::unordered_map<std::string, Symbol *> symbols;
-static std::unordered_map<std::string, std::vector<Symbol *>> localSymbols;
+// Keys view the names of the symbols themselves, which are never freed nor renamed
+static std::unordered_map<std::string_view, Symbol *> symbols;
+static std::vector<Symbol *> imports;
+// Only indexed by name if an error needs to list them
+static std::vector<Symbol const *> unexportedSymbols;
+static std::unordered_map<std::string_view, std::vector<Symbol const *>> localSymbols;
 
 void sym_ForEach(void (*callback)(Symbol &)) {
 	for (auto &it : symbols) {
@@ -27,11 +33,16 @@ void sym_ForEach(void (*callback)(Symbol &)) {
 	}
 }
 
+static ProfileCounter nbSymbols("symbols");
+
 void sym_AddSymbol(Symbol &symbol) {
-	if (symbol.type != SYMTYPE_EXPORT) {
-		if (symbol.type != SYMTYPE_IMPORT) {
-			localSymbols[symbol.name].push_back(&symbol);
-		}
+	++nbSymbols;
+
+	if (symbol.type == SYMTYPE_IMPORT) {
+		imports.push_back(&symbol);
+		return;
+	} else if (symbol.type != SYMTYPE_EXPORT) {
+		unexportedSymbols.push_back(&symbol);
 		return;
 	}
 
@@ -57,19 +68,33 @@ void sym_AddSymbol(Symbol &symbol) {
 	}
 
 	// If not, add it (potentially replacing the previous same-value symbol)
-	symbols[symbol.name] = &symbol;
+	symbols.insert_or_assign(symbol.name, &symbol);
 }
 
-Symbol *sym_GetSymbol(std::string const &name) {
+Symbol *sym_GetSymbol(std::string_view name) {
 	auto search = symbols.find(name);
 	return search != symbols.end() ? search->second : nullptr;
 }
 
-void sym_TraceLocalAliasedSymbols(std::string const &name) {
-	std::vector<Symbol *> const &locals = localSymbols[name];
-	if (locals.empty()) {
+void sym_ResolveImports() {
+	for (Symbol *symbol : imports) {
+		symbol->definition = sym_GetSymbol(symbol->name);
+	}
+}
+
+void sym_TraceLocalAliasedSymbols(std::string_view name) {
+	if (!unexportedSymbols.empty()) {
+		for (Symbol const *local : unexportedSymbols) {
+			localSymbols[local->name].push_back(local);
+		}
+		unexportedSymbols.clear();
+	}
+
+	auto search = localSymbols.find(name);
+	if (search == localSymbols.end()) {
 		return;
 	}
+	std::vector<Symbol const *> const &locals = search->second;
 
 	bool plural = locals.size() != 1;
 	fprintf(
@@ -81,7 +106,7 @@ void sym_TraceLocalAliasedSymbols(std::string const &name) {
 	);
 
 	size_t nbListed = 0;
-	for (Symbol *local : locals) {
+	for (Symbol const *local : locals) {
 		if (nbListed == 3) {
 			fprintf(stderr, "    ...and %zu more\n", locals.size() - nbListed);
 			break;
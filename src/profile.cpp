@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: MIT
+
+#include "profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <inttypes.h>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "helpers.hpp"  // RANGE
+#include "platform.hpp" // HAVE_GETRUSAGE, strcasecmp
+#include "version.hpp"
+
+enum ProfileFormat {
+	PROFILE_NONE,
+	PROFILE_TEXT,
+	PROFILE_JSON,
+};
+
+static ProfileFormat format = PROFILE_NONE;
+static uint32_t nbPhasesEntered = 0;
+static ProfileScope *currentScope = nullptr;
+static char const *reportedProgramName;
+static uint64_t nbAllocations = 0;
+
+// Counting allocations requires replacing the global allocator.
+// This is only linked into RGBASM and RGBLINK, which are single-threaded.
+// Every non-aligned form is replaced, so that they all agree on using `malloc` and `free`;
+// the aligned forms are left alone, since they pair with each other (and RGBDS does not use any).
+
+static void *allocate(size_t size) {
+	++nbAllocations;
+	for (;;) {
+		if (void *ptr = malloc(size ? size : 1); ptr) {
+			return ptr;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) {
+			return nullptr;
+		}
+		handler();
+	}
+}
+
+// Not inlined into callers, where GCC could not always tell that what they free is on the heap
+[[gnu::noinline]]
+static void deallocate(void *ptr) {
+	free(ptr);
+}
+
+void *operator new(size_t size) {
+	if (void *ptr = allocate(size); ptr) {
+		return ptr;
+	}
+	// This cannot use `fatal`, which may need to allocate
+	fputs("FATAL: Out of memory\n", stderr);
+	abort();
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept {
+	return allocate(size);
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	deallocate(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	deallocate(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::nothrow_t const &) noexcept {
+	deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept {
+	deallocate(ptr);
+}
+
+// These are function-local so that they exist before any phase or counter is constructed
+static std::vector<ProfilePhase *> &phases() {
+	static std::vector<ProfilePhase *> list;
+	return list;
+}
+static std::vector<ProfileCounter *> &counters() {
+	static std::vector<ProfileCounter *> list;
+	return list;
+}
+
+ProfilePhase::ProfilePhase(char const *name_) : name(name_) {
+	phases().push_back(this);
+}
+
+ProfileCounter::ProfileCounter(char const *name_) : name(name_) {
+	counters().push_back(this);
+}
+
+static int64_t getWallNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+	           std::chrono::steady_clock::now().time_since_epoch()
+	)
+	    .count();
+}
+
+#if HAVE_GETRUSAGE
+static int64_t getCpuUs() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * INT64_C(1000000)
+	       + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static long getPeakRssKiB() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	// macOS reports the peak RSS in bytes, other systems in KiB
+	#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+	#else
+	return usage.ru_maxrss;
+	#endif
+}
+#else
+static int64_t getCpuUs() {
+	return static_cast<int64_t>(clock()) * 1000000 / CLOCKS_PER_SEC;
+}
+
+static long getPeakRssKiB() {
+	return 0; // Not available
+}
+#endif
+
+ProfileScope::ProfileScope(ProfilePhase &phase) {
+	if (format == PROFILE_NONE) {
+		return;
+	}
+
+	_phase = &phase;
+	if (!phase.order) {
+		phase.order = ++nbPhasesEntered;
+	}
+	_parent = currentScope;
+	currentScope = this;
+
+	// The wall clock is read around the CPU time, since reading the latter takes a system call
+	_startWallNs = getWallNs();
+	_startCpuUs = getCpuUs();
+	_startAllocations = nbAllocations;
+}
+
+void ProfileScope::end() {
+	if (!_phase) {
+		return;
+	}
+
+	uint64_t allocations = nbAllocations - _startAllocations;
+	int64_t cpuUs = getCpuUs() - _startCpuUs;
+	int64_t wallNs = getWallNs() - _startWallNs;
+
+	// Only count what was not spent in nested phases
+	++_phase->nbCalls;
+	_phase->wallNs += wallNs - _childWallNs;
+	_phase->cpuUs += cpuUs - _childCpuUs;
+	_phase->nbAllocations += allocations - _childAllocations;
+
+	currentScope = _parent;
+	if (_parent) {
+		_parent->_childWallNs += wallNs;
+		_parent->_childCpuUs += cpuUs;
+		_parent->_childAllocations += allocations;
+	}
+	_phase = nullptr;
+}
+
+bool profile_Parse(char const *arg) {
+	if (!strcasecmp(arg, "text")) {
+		format = PROFILE_TEXT;
+	} else if (!strcasecmp(arg, "json")) {
+		format = PROFILE_JSON;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static void reportText(
+    char const *programName,
+    std::vector<ProfilePhase const *> const &enteredPhases,
+    std::vector<ProfileCounter const *> const &sortedCounters
+) {
+	fprintf(stderr, "Profile of %s %s:\n", programName, get_package_version_string());
+	fprintf(
+	    stderr,
+	    "%-20s %8s %12s %12s %12s\n",
+	    "Phase",
+	    "Calls",
+	    "Wall (ms)",
+	    "CPU (ms)",
+	    "Allocations"
+	);
+	for (ProfilePhase const *phase : enteredPhases) {
+		fprintf(
+		    stderr,
+		    "%-20s %8" PRIu64 " %12.3f %12.3f %12" PRIu64 "\n",
+		    phase->name,
+		    phase->nbCalls,
+		    phase->wallNs / 1e6,
+		    phase->cpuUs / 1e3,
+		    phase->nbAllocations
+		);
+	}
+	fprintf(stderr, "Peak RSS: %ld KiB\n", getPeakRssKiB());
+	fputs("Counters:\n", stderr);
+	for (ProfileCounter const *counter : sortedCounters) {
+		fprintf(stderr, "%-20s %12" PRIu64 "\n", counter->name, counter->value);
+	}
+}
+
+static void reportJSON(
+    char const *programName,
+    std::vector<ProfilePhase const *> const &enteredPhases,
+    std::vector<ProfileCounter const *> const &sortedCounters
+) {
+	// Names are all string literals, which never need escaping
+	fprintf(
+	    stderr,
+	    "{\"program\": \"%s\", \"version\": \"%s\", \"peak_rss_kib\": %ld, \"phases\": [",
+	    programName,
+	    get_package_version_string(),
+	    getPeakRssKiB()
+	);
+	for (size_t i = 0; i < enteredPhases.size(); ++i) {
+		ProfilePhase const &phase = *enteredPhases[i];
+		fprintf(
+		    stderr,
+		    "%s\n\t{\"name\": \"%s\", \"calls\": %" PRIu64 ", \"wall_ms\": %.3f"
+		    ", \"cpu_ms\": %.3f, \"allocations\": %" PRIu64 "}",
+		    i ? "," : "",
+		    phase.name,
+		    phase.nbCalls,
+		    phase.wallNs / 1e6,
+		    phase.cpuUs / 1e3,
+		    phase.nbAllocations
+		);
+	}
+	fputs("\n], \"counters\": {", stderr);
+	for (size_t i = 0; i < sortedCounters.size(); ++i) {
+		fprintf(
+		    stderr,
+		    "%s\n\t\"%s\": %" PRIu64,
+		    i ? "," : "",
+		    sortedCounters[i]->name,
+		    sortedCounters[i]->value
+		);
+	}
+	fputs("\n}}\n", stderr);
+}
+
+static void report() {
+	// `exit` may have been called from within phases, whose scopes will never end otherwise
+	while (currentScope) {
+		currentScope->end();
+	}
+
+	// Phases are listed in the order they were first entered, counters in alphabetical order
+	std::vector<ProfilePhase const *> enteredPhases;
+	for (ProfilePhase const *phase : phases()) {
+		if (phase->order) {
+			enteredPhases.push_back(phase);
+		}
+	}
+	std::sort(RANGE(enteredPhases), [](ProfilePhase const *lhs, ProfilePhase const *rhs) {
+		return lhs->order < rhs->order;
+	});
+	std::vector<ProfileCounter const *> sortedCounters(RANGE(counters()));
+	std::sort(RANGE(sortedCounters), [](ProfileCounter const *lhs, ProfileCounter const *rhs) {
+		return strcmp(lhs->name, rhs->name) < 0;
+	});
+
+	if (format == PROFILE_JSON) {
+		reportJSON(reportedProgramName, enteredPhases, sortedCounters);
+	} else {
+		reportText(reportedProgramName, enteredPhases, sortedCounters);
+	}
+}
+
+void profile_ReportAtExit(char const *programName) {
+	if (format == PROFILE_NONE) {
+		return;
+	}
+
+	reportedProgramName = programName;
+	atexit(report);
+}
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: MIT
+
+#include "romheader.hpp"
+
+#include <algorithm>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "helpers.hpp" // assume, clz, ctz
+
+uint8_t const nintendoLogo[48] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+};
+
+uint8_t header_MaxTitleLen(bool hasManufacturerCode, bool hasCGBFlag) {
+	return hasManufacturerCode ? HEADER_MANUFACTURER - HEADER_TITLE
+	       : hasCGBFlag        ? HEADER_CGB_FLAG - HEADER_TITLE
+	                           : HEADER_NEW_LICENSEE - HEADER_TITLE;
+}
+
+void HeaderWriter::writeBytes(
+    uint16_t addr, uint8_t const *bytes, size_t size, char const *fieldName
+) {
+	for (size_t i = 0; i < size; ++i) {
+		if (_rom0[addr + i] != 0 && _rom0[addr + i] != bytes[i]) {
+			_warnOverwrite(fieldName);
+			break;
+		}
+	}
+
+	memcpy(&_rom0[addr], bytes, size);
+}
+
+void HeaderWriter::writeLogo(uint8_t const (&logo)[48], char const *fieldName) {
+	writeBytes(HEADER_LOGO, logo, sizeof(logo), fieldName);
+}
+
+void HeaderWriter::writeTitle(std::string const &title, size_t len) {
+	assume(len <= title.length() && len <= header_MaxTitleLen(false, false));
+
+	writeBytes(HEADER_TITLE, reinterpret_cast<uint8_t const *>(title.data()), len, "title");
+}
+
+void HeaderWriter::writeCartridgeType(uint8_t type) {
+	writeByte(HEADER_CART_TYPE, type, "cartridge type");
+}
+
+void HeaderWriter::writeChecksum(bool invert) {
+	uint8_t sum = header_Checksum(_rom0);
+
+	writeByte(HEADER_CHECKSUM, invert ? ~sum : sum, "header checksum");
+}
+
+void HeaderWriter::writeGlobalChecksum(size_t rom0Len, uint16_t romxSum, bool invert) {
+	uint16_t sum = header_GlobalChecksum(_rom0, rom0Len, romxSum);
+	if (invert) {
+		sum = ~sum;
+	}
+
+	uint8_t bytes[2] = {static_cast<uint8_t>(sum >> 8), static_cast<uint8_t>(sum & 0xFF)};
+	writeBytes(HEADER_GLOBAL_SUM, bytes, sizeof(bytes), "global checksum");
+}
+
+uint16_t header_SumBytes(uint8_t const *data, size_t len) {
+	uint64_t total = 0;
+	size_t i = 0;
+
+	while (len - i >= 8) {
+		// Each 16-bit lane accumulates a pair of bytes at a time, so it can take 128 additions
+		// (of at most 2 * 0xFF each) before overflowing into the next lane
+		size_t end = i + std::min<size_t>((len - i) / 8, 128) * 8;
+		uint64_t lanes = 0;
+		for (; i < end; i += 8) {
+			uint64_t word;
+			memcpy(&word, &data[i], sizeof(word));
+			lanes += (word & 0x00FF'00FF'00FF'00FF) + (word >> 8 & 0x00FF'00FF'00FF'00FF);
+		}
+		total += (lanes & 0xFFFF) + (lanes >> 16 & 0xFFFF) + (lanes >> 32 & 0xFFFF) + (lanes >> 48);
+	}
+	for (; i < len; ++i) {
+		total += data[i];
+	}
+
+	return total;
+}
+
+uint8_t header_Checksum(uint8_t const *rom0) {
+	uint8_t sum = 0;
+
+	for (uint16_t i = HEADER_TITLE; i < HEADER_CHECKSUM; ++i) {
+		sum -= rom0[i] + 1;
+	}
+
+	return sum;
+}
+
+uint16_t header_GlobalChecksum(uint8_t const *rom0, size_t rom0Len, uint16_t romxSum) {
+	assume(rom0Len >= HEADER_END);
+
+	return romxSum + header_SumBytes(rom0, HEADER_GLOBAL_SUM)
+	       + header_SumBytes(&rom0[HEADER_END], rom0Len - HEADER_END);
+}
+
+// Padding is required by flashers, which flash to ROM chips, whose size is always a power of 2...
+// so there'd be no point in padding to something else.
+// Additionally, a ROM must be at least 32k, so we guarantee a whole amount of banks...
+uint32_t header_PaddedNbBanks(uint32_t nbBanks) {
+	// We want at least 2 banks
+	if (nbBanks < 2) {
+		return 2;
+	}
+	// x&(x-1) is zero iff x is a power of 2, or 0; we know for sure it's non-zero,
+	// so this is true (non-zero) when we don't have a power of 2
+	if (nbBanks & (nbBanks - 1)) {
+		nbBanks = 1 << (CHAR_BIT * sizeof(nbBanks) - clz(nbBanks));
+	}
+	return nbBanks;
+}
+
+uint8_t header_RomSizeCode(uint32_t nbBanks) {
+	assume(nbBanks >= 2 && !(nbBanks & (nbBanks - 1)));
+
+	return ctz(nbBanks / 2);
+}
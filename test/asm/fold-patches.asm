@@ -0,0 +1,26 @@
+; Patches which become constant by the end of assembly are resolved by RGBASM
+
+SECTION "fixed", ROM0[0]
+	jr Forward
+	jp Forward
+	ld hl, Forward - @
+	ldh a, [hForward]
+	bit FORWARD_BIT, a
+	rst ForwardVector
+	db BANK(Forward), LOW(Forward), HIGH(Forward)
+	dl Forward * 3
+	dw Floating ; Cannot be folded, since its section is floating
+Forward:
+	ret
+
+DEF FORWARD_BIT EQU 5
+DEF ForwardVector EQU $38
+
+SECTION "floating", ROM0
+Floating:
+	jr Floating2 ; Cannot be folded
+Floating2:
+	ret
+
+SECTION "hram", HRAM[$FF90]
+hForward: db
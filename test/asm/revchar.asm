@@ -21,3 +21,7 @@ test "y", 4, 5, 6, 7, 8, $99999999
 test "zed", 4660, 22136, 39612, 57072
 test "", 3 ; multiple
 test "", 4 ; none
+
+; new mappings invalidate the reverse lookups done so far
+charmap "w", 4
+test "w", 4
@@ -243,6 +243,72 @@ for variant in '' '.pipe'; do
 	fi
 done
 
+# Test that the profile is valid JSON, with the phases and counters that were entered
+i="profile"
+if type -t python3 >/dev/null; then
+	(( tests++ ))
+	echo "${bold}${green}${i}...${rescolors}${resbold}"
+	"$RGBASM" --profile json -o "$o" include-unique-id.asm >/dev/null 2>"$errput"
+	if ! python3 - "$errput" <<'EOF'; then
+import json, sys
+with open(sys.argv[1]) as f:
+	profile = json.load(f)
+assert profile["program"] == "rgbasm" and profile["peak_rss_kib"] >= 0
+assert "parsing" in [phase["name"] for phase in profile["phases"]]
+assert sum(phase["allocations"] for phase in profile["phases"]) > 0
+assert profile["counters"]["includes"] > 0 and profile["counters"]["tokens"] > 0
+EOF
+		echo "${bold}${red}${i} output is not a valid profile!${rescolors}${resbold}"
+		rc=1
+		(( failed++ ))
+	fi
+
+	# The profile is also printed when assembly is aborted, after the error messages
+	(( tests++ ))
+	echo "${bold}${green}${i} after fatal error...${rescolors}${resbold}"
+	"$RGBASM" --profile json -o "$o" fail.asm >/dev/null 2>"$errput"
+	if ! python3 - "$errput" <<'EOF'; then
+import json, sys
+with open(sys.argv[1]) as f:
+	errput = f.read()
+profile = json.loads(errput[errput.index('{"program"'):])
+assert profile["program"] == "rgbasm"
+assert "parsing" in [phase["name"] for phase in profile["phases"]]
+EOF
+		echo "${bold}${red}${i} output after fatal error is not a valid profile!${rescolors}${resbold}"
+		rc=1
+		(( failed++ ))
+	fi
+else
+	echo "${bold}${orange}Warning: cannot run profile test without Python!${rescolors}${resbold}"
+fi
+
+# Test that the trace events are a valid JSON array, with as many ends as beginnings
+i="trace-events"
+if type -t python3 >/dev/null; then
+	(( tests++ ))
+	echo "${bold}${green}${i}...${rescolors}${resbold}"
+	"$RGBASM" --trace-events "$output" -o "$o" include-unique-id.asm >/dev/null
+	if ! python3 - "$output" <<'EOF'; then
+import json, sys
+with open(sys.argv[1]) as f:
+	events = json.load(f)
+depth = 0
+for event in events:
+	depth += {"B": 1, "E": -1}[event["ph"]]
+	assert depth >= 0
+assert depth == 0
+categories = {event["cat"] for event in events if event["ph"] == "B"}
+assert {"INCLUDE", "MACRO", "REPT", "FOR"} <= categories
+EOF
+		echo "${bold}${red}${i} output is not a valid trace!${rescolors}${resbold}"
+		rc=1
+		(( failed++ ))
+	fi
+else
+	echo "${bold}${orange}Warning: cannot run trace-events test without Python!${rescolors}${resbold}"
+fi
+
 if [[ "$failed" -eq 0 ]]; then
 	echo "${bold}${green}All ${tests} tests passed!${rescolors}${resbold}"
 else
@@ -132,6 +132,9 @@ runSpecialTest no-exist no-exist
 # Check that RGBFIX errors out when not inputting any file
 runSpecialTest no-input
 
+# Check that RGBFIX reports errors in order when fixing multiple files concurrently
+runSpecialTest jobs --jobs 2 no-exist-1 no-exist-2 no-exist-3
+
 # Check that RGBFIX errors out when inputting multiple files with an output file
 runSpecialTest multiple-to-one one two three -o multiple-to-one
 
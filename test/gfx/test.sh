@@ -112,6 +112,47 @@ done
 newTest "$RGBGFX -m -o - write_stdout.bin > result.2bpp"
 runTest && tryCmp write_stdout.out.2bpp result.2bpp || failTest $?
 
+# Test that the packing search reaches the 6 palettes that the heuristic misses by one; either
+# strategy may find a packing first, so only the number of palettes is checked, not their colors
+newTest "$RGBGFX @pack_time.flags -p result.pal pack_time.png"
+runTest && [[ "$(wc -c <result.pal)" -eq $(( 6 * 4 * 2 )) ]] || failTest $?
+
+# Test restoring outputs from the cache, which the first run fills
+cachedir="$(mktemp -d)"
+for i in 1 2; do
+	rm -f result.{2bpp,pal,tilemap,attrmap}
+	newTest "$RGBGFX --cache ${cachedir@Q} @base_ids.flags -o result.2bpp -p result.pal -t result.tilemap -a result.attrmap base_ids.png"
+	runTest && checkOutput base_ids || failTest $?
+done
+rm -rf "$cachedir"
+
+# Test that an entry for other inputs is not restored, even if its name (the hash) matches
+cachedir="$(mktemp -d)"
+newTest "$RGBGFX --cache ${cachedir@Q} @base_ids.flags -o result.2bpp -p result.pal -t result.tilemap -a result.attrmap base_ids.png"
+runTest || failTest $?
+entry="$(ls "$cachedir")"
+rm -f "$cachedir/$entry"
+newTest "$RGBGFX --cache ${cachedir@Q} -o result.2bpp full_png.png"
+runTest && mv "$cachedir"/* "$cachedir/$entry" || failTest $?
+rm -f result.{2bpp,pal,tilemap,attrmap}
+newTest "$RGBGFX --cache ${cachedir@Q} @base_ids.flags -o result.2bpp -p result.pal -t result.tilemap -a result.attrmap base_ids.png"
+runTest && checkOutput base_ids || failTest $?
+rm -rf "$cachedir"
+
+# Test that conversions which print diagnostics are not cached, so they fail again, and that
+# caching a conversion without diagnostics does not hide them from other warning flags
+cachedir="$(mktemp -d)"
+werror=-Werror=trim-nonempty
+for wflag in "$werror" "$werror" -Wno-trim-nonempty "$werror"; do
+	newTest "$RGBGFX --cache ${cachedir@Q} -x 1000 $wflag -o result.2bpp full_png.png"
+	if [[ "$wflag" = -Wno-* ]]; then
+		runTest || failTest $?
+	else
+		! runTest 2>"$errtmp" && grep -q -- "$wflag" "$errtmp" || failTest
+	fi
+done
+rm -rf "$cachedir"
+
 if [[ "$failed" -eq 0 ]]; then
 	echo "${bold}${green}All ${tests} tests passed!${rescolors}${resbold}"
 else
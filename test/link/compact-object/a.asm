@@ -0,0 +1,15 @@
+SECTION "start", ROM0[$100]
+Start::
+	jp Main
+
+SECTION FRAGMENT "data", ROM0
+Table::
+	db 1, 2, 3
+	dw Main, Table
+REPT 2
+	db Answer + 1
+ENDR
+	assert Table + 9 == @, "Table has the wrong size"
+
+SECTION "vars", WRAM0
+wCounter:: ds 2
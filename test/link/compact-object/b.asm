@@ -0,0 +1,11 @@
+DEF Answer EQU 42
+EXPORT Answer
+
+SECTION "main", ROM0
+Main::
+	ld hl, wCounter
+	inc [hl]
+	jr Main
+
+SECTION FRAGMENT "data", ROM0
+	db "end"
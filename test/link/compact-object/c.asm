@@ -0,0 +1,6 @@
+; This piece is linked after the others, so its patches' PC offsets are only adjusted once its
+; deferred payload is loaded
+SECTION FRAGMENT "data", ROM0
+DataEnd::
+	jr Table
+	dw @, DataEnd, Table
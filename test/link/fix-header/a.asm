@@ -0,0 +1,19 @@
+section "header", rom0[$100]
+	nop
+	jp Start
+	; Not the logo, so this gets overwritten
+	db $42
+	ds $150 - @, 0
+
+Start::
+	jp Bank1
+
+section "bank 1", romx, bank[1]
+Bank1::
+	ld a, BANK(Bank3)
+	ld [$2000], a
+	jp Bank3
+
+section "bank 3", romx, bank[3]
+Bank3::
+	jr @
@@ -0,0 +1,14 @@
+IF !DEF(VALUE)
+	DEF VALUE EQU 1
+ENDC
+DEF Answer EQU VALUE * 21
+EXPORT Answer
+
+SECTION "header", ROM0[$100]
+	jp Main
+	ds $150 - @, 0
+
+SECTION "data", ROMX
+	db VALUE
+Data::
+	dw Main, Answer
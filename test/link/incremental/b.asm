@@ -0,0 +1,11 @@
+SECTION "main", ROM0
+Main::
+	ld a, BANK(Data)
+	ld [$2000], a
+	ld hl, Data
+	ld a, Answer
+	jr @
+
+SECTION "code", ROMX, BANK[2]
+	ld hl, Main
+	ds $100, $42
@@ -0,0 +1,7 @@
+IF !DEF(VALUE)
+	DEF VALUE EQU 1
+ENDC
+
+SECTION "independent", ROMX, BANK[3]
+	db VALUE
+	ds $10, VALUE * 3
@@ -157,6 +157,18 @@ tryDiff "$test"/ref.out.sym "$outtemp2"
 tryCmpRom "$test"/ref.out.bin
 evaluateTest
 
+test="compact-object"
+startTest
+"$RGBASM" --compact-object -o "$otemp" "$test"/a.asm
+"$RGBASM" -o "$gbtemp2" "$test"/b.asm
+"$RGBASM" --compact-object -o "$outtemp3" "$test"/c.asm
+continueTest
+rgblinkQuiet -o "$gbtemp" -n "$outtemp2" "$otemp" "$gbtemp2" "$outtemp3" 2>"$outtemp"
+tryDiff "$test"/out.err "$outtemp"
+tryDiff "$test"/ref.out.sym "$outtemp2"
+tryCmpRom "$test"/ref.out.bin
+evaluateTest
+
 test="export-all"
 startTest
 "$RGBASM" -E -o "$otemp" "$test"/a.asm
@@ -181,6 +193,23 @@ for test in fragment-align/*; do
 	evaluateTest
 done
 
+test="fix-header"
+startTest
+"$RGBASM" -o "$otemp" "$test"/a.asm
+continueTest
+rgblinkQuiet -p 0xff --fix-header --title "FIXED HEADER" --mbc-type 0x19 -o "$gbtemp" "$otemp" \
+	2>"$outtemp"
+tryDiff "$test"/out.err "$outtemp"
+# The header must be the same whether or not the output can be seeked back into
+"$RGBLINK" -p 0xff --fix-header --title "FIXED HEADER" --mbc-type 0x19 -o - "$otemp" \
+	2>/dev/null | cat >"$gbtemp2"
+tryCmp "$gbtemp" "$gbtemp2"
+# And it must be the same as fixing it with RGBFIX after the fact
+rgblinkQuiet -p 0xff -o "$gbtemp2" "$otemp"
+"$RGBFIX" -v -p 0xff -t "FIXED HEADER" -m 0x19 "$gbtemp2" 2>/dev/null
+tryCmp "$gbtemp" "$gbtemp2"
+evaluateTest
+
 test="fragment-literals"
 startTest
 "$RGBASM" -o "$otemp" "$test"/a.asm
@@ -191,6 +220,37 @@ tryDiff "$test"/ref.out.map "$outtemp"
 tryDiff "$test"/ref.out.sym "$outtemp2"
 evaluateTest
 
+test="incremental"
+startTest
+"$RGBASM" -o "$outtemp2" "$test"/b.asm
+for flags in "" --fix-header; do
+	continueTest "${flags:+ $flags}"
+	# shellcheck disable=SC2206 # (Splitting the flags is the desired behavior.)
+	flags=($flags)
+	# a.asm's object is compact, so its data is only hashed once it is loaded
+	"$RGBASM" --compact-object -o "$otemp" "$test"/a.asm
+	"$RGBASM" -o "$outtemp" "$test"/c.asm
+	# The state file starts out empty, so the first link is from scratch
+	: >"$outtemp3"
+	rgblinkQuiet "${flags[@]}" --incremental "$outtemp3" -o "$gbtemp" "$otemp" "$outtemp2" "$outtemp"
+	# Changing an object without resizing its sections only rewrites the banks that depend on it,
+	# which includes those of objects that import its symbols
+	"$RGBASM" --compact-object -DVALUE=2 -o "$otemp" "$test"/a.asm
+	rgblinkQuiet -vv "${flags[@]}" --incremental "$outtemp3" -o "$gbtemp" \
+		"$otemp" "$outtemp2" "$outtemp" 2>"$gbtemp2"
+	grep -q "2 of 3 objects need patching" "$gbtemp2" || tryDiff /dev/null "$gbtemp2"
+	rgblinkQuiet "${flags[@]}" -o "$gbtemp2" "$otemp" "$outtemp2" "$outtemp"
+	tryCmp "$gbtemp" "$gbtemp2"
+	# Changing an independent object leaves the other banks as they were
+	"$RGBASM" -DVALUE=3 -o "$outtemp" "$test"/c.asm
+	rgblinkQuiet -vv "${flags[@]}" --incremental "$outtemp3" -o "$gbtemp" \
+		"$otemp" "$outtemp2" "$outtemp" 2>"$gbtemp2"
+	grep -q "1 of 3 objects need patching" "$gbtemp2" || tryDiff /dev/null "$gbtemp2"
+	rgblinkQuiet "${flags[@]}" -o "$gbtemp2" "$otemp" "$outtemp2" "$outtemp"
+	tryCmp "$gbtemp" "$gbtemp2"
+	evaluateTest
+done
+
 test="jr-wraparound"
 startTest
 "$RGBASM" -o "$otemp" "$test"/a.asm